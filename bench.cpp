@@ -0,0 +1,383 @@
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include <utxt.h>
+
+// A font with made up metrics, so the benchmarks don't depend on a font file.
+// Glyphs are placed in a grid of 64x32 pixel cells in the atlas. There is always a space glyph.
+static utxt_font* create_font(uint32_t first_cp, uint32_t last_cp, float advance, bool atlas)
+{
+    const auto num_glyphs = last_cp - first_cp + 1;
+    const uint32_t atlas_width = 64 * 16;
+    const uint32_t atlas_height = atlas ? (num_glyphs + 63) / 64 * 32 : 1;
+    std::vector<uint8_t> atlas_data;
+    if (atlas) {
+        atlas_data.resize(atlas_width * atlas_height);
+        for (size_t i = 0; i < atlas_data.size(); ++i) {
+            atlas_data[i] = (uint8_t)(i * 2654435761u >> 24);
+        }
+    }
+
+    std::vector<utxt_glyph> glyphs;
+    if (first_cp > ' ') {
+        glyphs.push_back({ .codepoint = ' ', .glyph_index = ' ', .advance = advance / 2.0f });
+    }
+    for (uint32_t cp = first_cp; cp <= last_cp; ++cp) {
+        const auto cell_x = (float)((cp - first_cp) % 64 * 16);
+        const auto cell_y = (float)((cp - first_cp) / 64 * 32);
+        const auto width = advance - 2.0f;
+        const auto height = 18.0f;
+        glyphs.push_back({
+            .codepoint = cp,
+            .glyph_index = cp,
+            .bearing_x = 1.0f,
+            .bearing_y = -14.0f,
+            .width = width,
+            .height = height,
+            .advance = advance,
+            .u0 = cell_x / (float)atlas_width,
+            .v0 = cell_y / (float)atlas_height,
+            .u1 = (cell_x + width) / (float)atlas_width,
+            .v1 = (cell_y + height) / (float)atlas_height,
+        });
+    }
+    const utxt_font_metrics metrics { 18.0f, -6.0f, 0.0f, 24.0f };
+    return utxt_font_create({}, {
+                                    .atlas_data = atlas ? atlas_data.data() : nullptr,
+                                    .atlas_width = atlas_width,
+                                    .atlas_height = atlas_height,
+                                    .metrics = metrics,
+                                    .glyphs = glyphs.data(),
+                                    .num_glyphs = glyphs.size(),
+                                });
+}
+
+static std::vector<char> generate_words(size_t num_words)
+{
+    std::vector<char> text;
+    uint32_t rng = 12345;
+    for (size_t w = 0; w < num_words; ++w) {
+        rng = rng * 1664525u + 1013904223u;
+        const auto len = 2 + (rng >> 28);
+        for (uint32_t c = 0; c < len; ++c) {
+            rng = rng * 1664525u + 1013904223u;
+            text.push_back((char)('a' + (rng >> 24) % 26));
+        }
+        text.push_back(' ');
+    }
+    return text;
+}
+
+static void append_utf8(std::vector<char>& text, uint32_t cp)
+{
+    if (cp < 0x80) {
+        text.push_back((char)cp);
+    } else if (cp < 0x800) {
+        text.push_back((char)(0xC0 | (cp >> 6)));
+        text.push_back((char)(0x80 | (cp & 0x3F)));
+    } else if (cp < 0x10000) {
+        text.push_back((char)(0xE0 | (cp >> 12)));
+        text.push_back((char)(0x80 | ((cp >> 6) & 0x3F)));
+        text.push_back((char)(0x80 | (cp & 0x3F)));
+    } else {
+        text.push_back((char)(0xF0 | (cp >> 18)));
+        text.push_back((char)(0x80 | ((cp >> 12) & 0x3F)));
+        text.push_back((char)(0x80 | ((cp >> 6) & 0x3F)));
+        text.push_back((char)(0x80 | (cp & 0x3F)));
+    }
+}
+
+// CJK Unified Ideographs without spaces, with a line break every few hundred characters.
+static std::vector<char> generate_cjk(size_t num_chars)
+{
+    std::vector<char> text;
+    uint32_t rng = 12345;
+    for (size_t i = 0; i < num_chars; ++i) {
+        rng = rng * 1664525u + 1013904223u;
+        append_utf8(text, (rng >> 16) % 300 == 0 ? '\n' : 0x4E00 + (rng >> 8) % 0x5200);
+    }
+    return text;
+}
+
+template <typename Func>
+static void bench(const char* name, size_t items, size_t iterations, Func&& func)
+{
+    func(); // warm up
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+        func();
+    }
+    const auto dur = std::chrono::duration<double>(std::chrono::steady_clock::now() - start);
+    const auto ns_per_item = dur.count() * 1e9 / (double)(items * iterations);
+    std::printf("%-40s %8.3f ns/item\n", name, ns_per_item);
+}
+
+static void bench_get_quads(utxt_font* font)
+{
+    const auto text = generate_words(20'000);
+    utxt_layout* layout = utxt_layout_create({}, (uint32_t)text.size());
+    utxt_layout_reset(layout, 800.0f, UTXT_TEXT_ALIGN_LEFT);
+    utxt_layout_add_text(layout, font, { text.data(), text.size() });
+    utxt_layout_compute(layout);
+
+    size_t num_glyphs = 0;
+    const auto glyphs = utxt_layout_get_glyphs(layout, &num_glyphs);
+    std::vector<utxt_quad> quads(num_glyphs);
+
+    bench("layout_glyph_get_quads", num_glyphs, 200,
+        [&] { utxt_layout_glyph_get_quads(glyphs, num_glyphs, quads.data(), 10.0f, 20.0f); });
+
+    utxt_layout_free(layout);
+}
+
+static void bench_render(utxt_font* font)
+{
+    const utxt_string label = UTXT_LITERAL("Label 1234");
+    std::vector<utxt_quad> quads(label.len);
+    const auto num_quads = utxt_draw_text(quads.data(), quads.size(), font, label, 0.0f, 0.0f);
+
+    const uint32_t width = 1920, height = 1080;
+    std::vector<utxt_render_job> jobs;
+    uint32_t rng = 12345;
+    for (size_t i = 0; i < 5000; ++i) {
+        rng = rng * 1664525u + 1013904223u;
+        const auto x = (float)(rng % width);
+        rng = rng * 1664525u + 1013904223u;
+        const auto y = (float)(rng % height);
+        jobs.push_back({ quads.data(), num_quads, x, y, { 255, 200, 100, 255 } });
+    }
+
+    std::vector<uint8_t> pixels(width * height * 4);
+    const utxt_image image { pixels.data(), width, height, 4 };
+    const auto total_quads = jobs.size() * num_quads;
+
+    bench("render_quads (5000 labels)", total_quads, 10, [&] {
+        for (const auto& job : jobs) {
+            utxt_render_quads(
+                image, font, job.quads, job.num_quads, job.x, job.y, job.color, nullptr);
+        }
+    });
+    bench("render_batch (5000 labels)", total_quads, 10,
+        [&] { utxt_render_batch(image, font, jobs.data(), jobs.size(), {}); });
+    for (const uint32_t num_threads : { 1u, 2u, 4u, 8u }) {
+        char name[64];
+        std::snprintf(name, sizeof(name), "render_batch (5000 labels, %u threads)", num_threads);
+        bench(name, total_quads, 10, [&] {
+            utxt_render_batch(
+                image, font, jobs.data(), jobs.size(), { .num_threads = num_threads });
+        });
+    }
+}
+
+static void bench_add_glyphs(utxt_font* font)
+{
+    const auto text = generate_cjk(200'000);
+    const auto num_chars = text.size() / 3;
+    utxt_layout* layout = utxt_layout_create({}, (uint32_t)num_chars);
+
+    // This is what you had to do before utxt_layout_add_glyphs existed
+    bench("layout_add_text (per character, CJK)", num_chars, 10, [&] {
+        utxt_layout_reset(layout, 800.0f, UTXT_TEXT_ALIGN_LEFT);
+        utxt_string s { text.data(), text.size() };
+        while (s.len) {
+            const auto len = ((uint8_t)s.data[0] & 0x80) ? (size_t)3 : (size_t)1;
+            utxt_layout_add_text(layout, font, { s.data, len });
+            s = { s.data + len, s.len - len };
+        }
+        utxt_layout_compute(layout);
+    });
+    bench("layout_add_glyphs (CJK)", num_chars, 10, [&] {
+        utxt_layout_reset(layout, 800.0f, UTXT_TEXT_ALIGN_LEFT);
+        utxt_layout_add_glyphs(layout, font, { text.data(), text.size() });
+        utxt_layout_compute(layout);
+    });
+
+    utxt_layout_free(layout);
+}
+
+static void bench_add_text_parallel(utxt_font* font)
+{
+    auto text = generate_words(500'000);
+    // Paragraphs of 50 words
+    size_t num_spaces = 0;
+    for (auto& c : text) {
+        if (c == ' ' && ++num_spaces % 50 == 0) {
+            c = '\n';
+        }
+    }
+    utxt_layout* layout = utxt_layout_create({}, 0);
+    utxt_layout_set_growth(layout, UTXT_LAYOUT_GROWTH_GROW);
+
+    bench("layout_add_text (500k words)", text.size(), 10, [&] {
+        utxt_layout_reset(layout, 800.0f, UTXT_TEXT_ALIGN_LEFT);
+        utxt_layout_add_text(layout, font, { text.data(), text.size() });
+        utxt_layout_compute(layout);
+    });
+    bench("layout_add_text_parallel (500k words)", text.size(), 10, [&] {
+        utxt_layout_reset(layout, 800.0f, UTXT_TEXT_ALIGN_LEFT);
+        utxt_layout_add_text_parallel(layout, font, { text.data(), text.size() }, {});
+        utxt_layout_compute(layout);
+    });
+
+    utxt_layout_free(layout);
+}
+
+static void bench_measure(utxt_font* font)
+{
+    const auto text = generate_words(200);
+    utxt_layout* layout = utxt_layout_create({}, (uint32_t)text.size());
+
+    bench("layout_add_text (to measure)", text.size(), 2000, [&] {
+        utxt_layout_reset(layout, 400.0f, UTXT_TEXT_ALIGN_LEFT);
+        utxt_layout_add_text(layout, font, { text.data(), text.size() });
+        utxt_layout_compute(layout);
+        size_t num_lines = 0;
+        utxt_layout_get_lines(layout, &num_lines);
+    });
+    bench("measure_text", text.size(), 2000,
+        [&] { utxt_measure_text(font, { text.data(), text.size() }, 400.0f); });
+
+    utxt_layout_free(layout);
+}
+
+static void bench_layout_cache(utxt_font* font)
+{
+    const auto text = generate_words(10);
+    utxt_layout* layout = utxt_layout_create({}, (uint32_t)text.size());
+    utxt_layout_cache* cache = utxt_layout_cache_create({}, 1024 * 1024);
+    const utxt_string str { text.data(), text.size() };
+
+    bench("layout_add_text (label)", text.size(), 100'000, [&] {
+        utxt_layout_reset(layout, 200.0f, UTXT_TEXT_ALIGN_CENTER);
+        utxt_layout_add_text(layout, font, str);
+        utxt_layout_compute(layout);
+    });
+    bench("layout_cache_get (label)", text.size(), 100'000, [&] {
+        size_t count = 0;
+        utxt_layout_cache_get(cache, font, str, 200.0f, UTXT_TEXT_ALIGN_CENTER, &count);
+    });
+
+    utxt_layout_cache_free(cache);
+    utxt_layout_free(layout);
+}
+
+static void bench_word_cache(utxt_font* font)
+{
+    // A small vocabulary, so words repeat a lot
+    const auto words = generate_words(200);
+    std::vector<char> text;
+    for (size_t i = 0; i < 200; ++i) {
+        text.insert(text.end(), words.begin(), words.end());
+    }
+    utxt_layout* layout = utxt_layout_create({}, (uint32_t)text.size());
+    utxt_word_cache* cache = utxt_word_cache_create({}, 1024);
+
+    bench("layout_add_text (repeated words)", text.size(), 20, [&] {
+        utxt_layout_reset(layout, 800.0f, UTXT_TEXT_ALIGN_LEFT);
+        utxt_layout_add_text(layout, font, { text.data(), text.size() });
+        utxt_layout_compute(layout);
+    });
+    utxt_layout_set_word_cache(layout, cache);
+    bench("layout_add_text (word cache)", text.size(), 20, [&] {
+        utxt_layout_reset(layout, 800.0f, UTXT_TEXT_ALIGN_LEFT);
+        utxt_layout_add_text(layout, font, { text.data(), text.size() });
+        utxt_layout_compute(layout);
+    });
+
+    utxt_word_cache_free(cache);
+    utxt_layout_free(layout);
+}
+
+static void bench_truncate(utxt_font* font)
+{
+    const auto text = generate_words(20);
+    const utxt_string str { text.data(), text.size() };
+    const utxt_string ellipsis = UTXT_LITERAL("...");
+    std::vector<utxt_quad> quads(text.size() + ellipsis.len);
+
+    // What you had to do before utxt_truncate_text existed
+    bench("truncate (shrinking get_text_width)", text.size(), 10'000, [&] {
+        const auto ellipsis_width = utxt_get_text_width(font, ellipsis);
+        auto len = str.len;
+        while (len && utxt_get_text_width(font, { str.data, len }) + ellipsis_width > 100.0f) {
+            len--;
+        }
+        const auto n = utxt_draw_text(quads.data(), quads.size(), font, { str.data, len }, 0, 0);
+        utxt_draw_text(quads.data() + n, quads.size() - n, font, ellipsis, 0, 0);
+    });
+    bench("truncate_text", text.size(), 10'000, [&] {
+        utxt_truncate_text(quads.data(), quads.size(), font, str, 0, 0, 100.0f, ellipsis);
+    });
+}
+
+static void bench_text_widths(utxt_font* font)
+{
+    const auto text = generate_words(50'000);
+    std::vector<utxt_string> cells;
+    for (size_t start = 0, i = 0; i < text.size(); ++i) {
+        if (text[i] == ' ') {
+            cells.push_back({ text.data() + start, i - start });
+            start = i + 1;
+        }
+    }
+    std::vector<float> widths(cells.size());
+
+    bench("get_text_width (50k cells)", text.size(), 50, [&] {
+        for (size_t i = 0; i < cells.size(); ++i) {
+            widths[i] = utxt_get_text_width(font, cells[i]);
+        }
+    });
+    bench("get_text_widths (50k cells, 1 thread)", text.size(), 50, [&] {
+        utxt_get_text_widths(font, cells.data(), widths.data(), cells.size(), { {}, 1 });
+    });
+    const utxt_text_widths_params params { {}, std::thread::hardware_concurrency() };
+    bench("get_text_widths (50k cells, all threads)", text.size(), 50,
+        [&] { utxt_get_text_widths(font, cells.data(), widths.data(), cells.size(), params); });
+}
+
+static void bench_arena(utxt_font* font)
+{
+    const auto text = generate_words(20);
+    const utxt_string str { text.data(), text.size() };
+    utxt_arena* arena = utxt_arena_create({}, 0);
+
+    // A layout that only lives for a frame
+    bench("layout_create (heap)", text.size(), 100'000, [&] {
+        utxt_layout* layout = utxt_layout_create({}, 0);
+        utxt_layout_set_growth(layout, UTXT_LAYOUT_GROWTH_GROW);
+        utxt_layout_add_text(layout, font, str);
+        utxt_layout_compute(layout);
+        utxt_layout_free(layout);
+    });
+    bench("layout_create (arena)", text.size(), 100'000, [&] {
+        utxt_layout* layout = utxt_layout_create(utxt_arena_get_alloc(arena), 0);
+        utxt_layout_set_growth(layout, UTXT_LAYOUT_GROWTH_GROW);
+        utxt_layout_add_text(layout, font, str);
+        utxt_layout_compute(layout);
+        utxt_arena_reset(arena, 0);
+    });
+
+    utxt_arena_free(arena);
+}
+
+int main()
+{
+    utxt_font* latin = create_font(0x20, 0x7e, 10.0f, true);
+    utxt_font* cjk = create_font(0x4E00, 0x9FFF, 20.0f, false);
+
+    bench_get_quads(latin);
+    bench_render(latin);
+    bench_add_glyphs(cjk);
+    bench_add_text_parallel(latin);
+    bench_measure(latin);
+    bench_layout_cache(latin);
+    bench_word_cache(latin);
+    bench_truncate(latin);
+    bench_text_widths(latin);
+    bench_arena(latin);
+
+    utxt_font_free(cjk);
+    utxt_font_free(latin);
+}
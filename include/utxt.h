@@ -15,6 +15,7 @@ typedef struct {
 #define UTXT_LITERAL(s) { s, sizeof(s) - 1 }
 utxt_string utxt_zstr(const char* str); // calls strlen for length
 
+// Returns the error of the last call that failed on the calling thread.
 utxt_string utxt_get_last_error();
 
 typedef void* (*utxt_realloc)(void* ptr, size_t old_size, size_t new_size, void* ctx);
@@ -24,6 +25,24 @@ typedef struct {
     void* ctx;
 } utxt_alloc;
 
+// Arena (bump) allocator, e.g. for layouts that only live for a frame: Allocations are taken from
+// big blocks (block_size, default 64 KiB) from the backing allocator. Freeing or resizing the most
+// recent allocation happens in place, all other frees do nothing. Reset the arena to a mark to
+// release everything allocated after it at once. The blocks are kept and reused, so after warming
+// up, allocating from the arena does not touch the backing allocator at all.
+// An arena must not be used by multiple threads at once (e.g. for utxt_layout_parallel_params).
+typedef struct utxt_arena utxt_arena;
+
+utxt_arena* utxt_arena_create(utxt_alloc backing, size_t block_size);
+void utxt_arena_free(utxt_arena* arena);
+// Valid until the arena is freed.
+utxt_alloc utxt_arena_get_alloc(utxt_arena* arena);
+size_t utxt_arena_mark(const utxt_arena* arena);
+// Everything allocated after mark must not be used anymore. utxt_arena_reset(arena, 0) resets all.
+void utxt_arena_reset(utxt_arena* arena, size_t mark);
+// Total size of all blocks.
+size_t utxt_arena_get_capacity(const utxt_arena* arena);
+
 /*
    This library takes a sequence of utf8 encoded unicode code points (text), maps them to glyphs
    in a font and tells you where to draw those glyphs as quads with texture coordinates.
@@ -94,6 +113,11 @@ typedef struct {
     float amount;
 } utxt_kerning_pair;
 
+// Fonts never change after they are created (dynamic fonts only add glyphs in a thread-safe way),
+// so all functions that take a const utxt_font* (e.g. drawing, measuring and layout) may be called
+// from any number of threads at once, as long as the font is not freed in the meantime. Everything
+// else (layouts, caches, arenas, quad buffers) must not be used by multiple threads at once, unless
+// stated otherwise.
 typedef struct utxt_font utxt_font;
 
 typedef struct {
@@ -111,6 +135,7 @@ typedef struct {
 utxt_font* utxt_font_load_ttf_buffer(
     utxt_alloc alloc, const uint8_t* data, size_t size, utxt_load_ttf_params params);
 
+// The file is read with malloc and freed before returning, alloc is used for everything else.
 utxt_font* utxt_font_load_ttf(utxt_alloc alloc, const char* path, utxt_load_ttf_params params);
 
 typedef struct {
@@ -127,10 +152,47 @@ typedef struct {
 
 utxt_font* utxt_font_create(utxt_alloc alloc, utxt_font_create_params params);
 
+typedef struct {
+    float size; // The target vertical extent in pixels (ascent - descent)
+    uint32_t atlas_size; // default: 1024
+    uint32_t font_index;
+    uint32_t max_glyphs; // default: 1024
+} utxt_dynamic_font_params;
+
+// Creates a font that rasterizes glyphs into its atlas (without oversampling) the first time they
+// are looked up, instead of packing fixed code point ranges up front. Use this for big character
+// sets like CJK. data is used until the font is freed, so it has to stay valid.
+// Dynamic fonts can still be used from multiple threads at once: Finding glyphs that were already
+// added does not lock and only one of the threads that miss the same glyph at the same time adds
+// it, while the others wait for it. Glyphs are rasterized on the threads that miss them, which
+// also allocate temporary bitmaps from alloc, so alloc must be thread-safe.
+// Code points that are not in the font or don't fit anymore (into max_glyphs or the atlas) are
+// skipped like code points outside the ranges of a loaded font. Use utxt_get_atlas_version to know
+// when to upload the atlas again.
+utxt_font* utxt_font_create_dynamic(
+    utxt_alloc alloc, const uint8_t* data, size_t size, utxt_dynamic_font_params params);
+
 void utxt_font_free(utxt_font* font);
 
+// A font is a single contiguous block of memory without any pointers in it, so it can be saved to
+// a file and used again without loading the TTF, e.g. by mapping the file into memory. The blob is
+// only valid for the same version of this library on the same platform (e.g. byte order).
+// Blobs of dynamic fonts (see utxt_font_create_dynamic) can not be used with utxt_font_from_blob.
+const void* utxt_font_get_blob(const utxt_font* font, size_t* size);
+// Uses data directly without copying it, so it has to stay valid and unchanged while the font is
+// used. data must be aligned to 8 bytes. Do not free the result. Returns NULL if data is not a
+// valid font blob.
+const utxt_font* utxt_font_from_blob(const void* data, size_t size);
+
+// The atlas of a dynamic font changes while glyphs are added, use utxt_copy_atlas if that can
+// happen on other threads.
 const uint8_t* utxt_get_atlas(
     const utxt_font* font, uint32_t* width, uint32_t* height, uint32_t* channels);
+// Incremented whenever glyphs are added to the atlas of a dynamic font (always 0 for other fonts).
+uint64_t utxt_get_atlas_version(const utxt_font* font);
+// Copies the atlas (width * height * channels bytes) to dst, even while other threads add glyphs to
+// a dynamic font. Returns the version of the copied atlas.
+uint64_t utxt_copy_atlas(const utxt_font* font, uint8_t* dst);
 
 const utxt_font_metrics* utxt_get_font_metrics(const utxt_font* font);
 
@@ -145,6 +207,41 @@ float utxt_get_kerning(const utxt_font* font, uint32_t first_glyph, uint32_t sec
 // This means the function is not linear (i.e. get_width(a + b) != get_width(a) + get_width(b)).
 float utxt_get_text_width(const utxt_font* font, utxt_string string);
 
+typedef struct {
+    utxt_alloc alloc; // used for temporary allocations
+    uint32_t num_threads; // default: 1, i.e. no threads are started unless this is set
+} utxt_text_widths_params;
+
+// Computes utxt_get_text_width for many texts (e.g. to size table columns) with identical results.
+// Lookup tables for ASCII are built once and shared, ASCII is not decoded and the texts are split
+// across threads. Dynamic fonts don't use the tables, so only the glyphs in the texts are added.
+void utxt_get_text_widths(const utxt_font* font, const utxt_string* texts, float* widths,
+    size_t count, utxt_text_widths_params params);
+
+// Positions of the glyphs of a single line of text (like utxt_draw_text places them, relative to
+// x = 0), from which the advance and visual width of any range of glyphs can be computed in O(1).
+// Build them once per string instead of calling utxt_get_text_width for every substring.
+typedef struct {
+    const utxt_glyph* glyph;
+    size_t text_offset; // byte offset of the glyph in the text
+    float x; // cursor position (including kerning with the previous glyph)
+    float x0, x1; // left and right edge of the glyph's bounding box
+} utxt_glyph_position;
+
+// Returns the number of positions. If positions is NULL, returns the number of positions that
+// would have been generated. Returns num_positions + 1 if the buffer is too small.
+// A buffer of text.len positions is always large enough.
+size_t utxt_get_glyph_positions(utxt_glyph_position* positions, size_t num_positions,
+    const utxt_font* font, utxt_string text);
+// Distance the cursor moves over the glyphs [first, end), e.g. the caret position after a prefix.
+float utxt_glyph_positions_get_advance(
+    const utxt_glyph_position* positions, size_t first, size_t end);
+// Like utxt_get_text_width for the glyphs [first, end).
+float utxt_glyph_positions_get_width(
+    const utxt_glyph_position* positions, size_t first, size_t end);
+// Returns the index of the glyph the caret should go before for position x (in O(log n)).
+size_t utxt_glyph_positions_find(const utxt_glyph_position* positions, size_t count, float x);
+
 typedef struct {
     float x, y, w, h;
     float u0, v0, u1, v1;
@@ -155,9 +252,48 @@ typedef struct {
 // Returns number of quads. If quads is NULL, returns the number of quads that would have been
 // generated.
 // Returns num_quads + 1 if the buffer is too small.
+// Every glyph takes at least one byte, so a buffer of text.len quads is always large enough. Use
+// that instead of calling this function twice, which decodes the text twice.
 size_t utxt_draw_text(
     utxt_quad* quads, size_t num_quads, const utxt_font* font, utxt_string text, float x, float y);
 
+// Like utxt_draw_text, but if the text is wider than max_width (see utxt_get_text_width), it is cut
+// after the last glyph that still leaves room for the ellipsis (e.g. "..." or "\u2026"), which is
+// added to the quads. Trailing whitespace before the ellipsis is dropped. If not even the ellipsis
+// fits, only the ellipsis is generated.
+// The text is only decoded up to the glyph that does not fit, so this is cheap for long texts.
+// A buffer of text.len + ellipsis.len quads is always large enough.
+size_t utxt_truncate_text(utxt_quad* quads, size_t num_quads, const utxt_font* font,
+    utxt_string text, float x, float y, float max_width, utxt_string ellipsis);
+
+typedef struct {
+    utxt_alloc alloc; // may be zero-initialized
+    utxt_quad* quads;
+    size_t num_quads;
+    size_t capacity;
+} utxt_quad_buffer;
+
+// Appends the quads for text to the buffer, growing it if necessary, in a single pass.
+// Initialize the buffer with zeros (and optionally an allocator) and use utxt_quad_buffer_free to
+// free it. Set num_quads to 0 to reuse the memory. Returns number of quads added.
+size_t utxt_draw_text_append(
+    utxt_quad_buffer* buffer, const utxt_font* font, utxt_string text, float x, float y);
+void utxt_quad_buffer_free(utxt_quad_buffer* buffer);
+
+typedef struct {
+    float x, y, w, h;
+} utxt_rect;
+
+typedef enum {
+    UTXT_CLIP_CULL = 0, // skip quads that are fully outside of the clip rect
+    UTXT_CLIP_CROP = 1, // also crop partially visible quads and their texture coordinates
+} utxt_clip_mode;
+
+// Like utxt_draw_text, but only generates quads that are (partially) inside the clip rect.
+// Use this for text in scroll views, so you only upload what is actually visible.
+size_t utxt_draw_text_clipped(utxt_quad* quads, size_t num_quads, const utxt_font* font,
+    utxt_string text, float x, float y, utxt_rect clip, utxt_clip_mode mode);
+
 typedef struct {
     utxt_string text; // in: text, out: remaining text
     float cursor_x; // in/out
@@ -171,15 +307,67 @@ typedef struct {
 size_t utxt_draw_text_batch(utxt_quad* quads, size_t num_quads, const utxt_font* font,
     utxt_draw_text_state* state, float y);
 
+// Instanced rendering: Instead of a quad per glyph, you upload the glyph table once and then only
+// a small instance record per glyph. The shader looks up the size and texture coordinates of the
+// quad in the glyph table using the instance's glyph index.
+
+typedef struct {
+    float width, height;
+    float u0, v0, u1, v1;
+} utxt_glyph_table_entry;
+
+typedef struct {
+    float x, y; // top-left corner of the quad, same as utxt_quad.x/y
+    uint32_t glyph; // index into the glyph table (same as the index into utxt_get_glyphs)
+} utxt_glyph_instance;
+
+// Fills the glyph table for instanced rendering with an entry for every glyph in utxt_get_glyphs.
+// Returns the number of entries. If table is NULL, returns the number of entries required.
+// Returns num_entries + 1 if the buffer is too small.
+size_t utxt_get_glyph_table(
+    const utxt_font* font, utxt_glyph_table_entry* table, size_t num_entries);
+
+// Like utxt_draw_text, but generates instances instead of quads.
+size_t utxt_draw_text_instances(utxt_glyph_instance* instances, size_t num_instances,
+    const utxt_font* font, utxt_string text, float x, float y);
+
 // Fancy text layouting API for all sorts of stuff (dialogue boxes, embedding symbols in text,
 // embedded markup, etc.).
 // Note that you only have to (and want to) layout the text when it changes, not every frame.
 
 typedef struct utxt_layout utxt_layout;
 
+// num_glyphs is the initial capacity. By default it is fixed and glyphs that don't fit are dropped,
+// starting with the first word that does not fit completely, until the next reset or rewind.
 utxt_layout* utxt_layout_create(utxt_alloc alloc, uint32_t num_glyphs);
 void utxt_layout_free(utxt_layout* layout);
 
+typedef enum {
+    UTXT_LAYOUT_GROWTH_NONE = 0, // glyphs that don't fit are dropped (default)
+    UTXT_LAYOUT_GROWTH_GROW = 1, // the capacity doubles when it is exceeded
+    UTXT_LAYOUT_GROWTH_SHRINK = 2, // like GROW, but reset shrinks to what the last layout needed
+} utxt_layout_growth;
+
+void utxt_layout_set_growth(utxt_layout* layout, utxt_layout_growth growth);
+
+// Word cache: Stores words laid out by utxt_layout_add_text (up to 16 bytes, keyed by font and
+// bytes), so words that repeat often (e.g. "the" or identifiers in code) don't have to be decoded,
+// looked up and kerned again. num_entries is rounded up to a power of two. The cache is
+// direct-mapped, so a word replaces whatever was in its entry before.
+// A cache can be shared by multiple layouts and fonts, but not used by multiple threads at once.
+// Clear it when you free a font that was used with it.
+typedef struct utxt_word_cache utxt_word_cache;
+
+utxt_word_cache* utxt_word_cache_create(utxt_alloc alloc, uint32_t num_entries);
+void utxt_word_cache_free(utxt_word_cache* cache);
+void utxt_word_cache_clear(utxt_word_cache* cache);
+// cache may be NULL to stop using it. The result of the layout does not change.
+void utxt_layout_set_word_cache(utxt_layout* layout, utxt_word_cache* cache);
+size_t utxt_layout_get_capacity(const utxt_layout* layout);
+// Returns the number of glyphs needed to hold all text added since the last reset, including glyphs
+// that were dropped, because the capacity was exceeded.
+size_t utxt_layout_get_required_capacity(const utxt_layout* layout);
+
 typedef enum {
     UTXT_TEXT_ALIGN_LEFT = 0,
     UTXT_TEXT_ALIGN_CENTER = 1,
@@ -194,23 +382,217 @@ void utxt_layout_reset(utxt_layout* layout, float wrap_width, utxt_text_align al
 size_t utxt_layout_add_text(utxt_layout* layout, const utxt_font* font, utxt_string text);
 // This function will wrap individual glyphs. Use this for e.g. CJK.
 size_t utxt_layout_add_glyphs(utxt_layout* layout, const utxt_font* font, utxt_string text);
+
+typedef struct {
+    utxt_alloc alloc; // used for temporary allocations from multiple threads at once
+    uint32_t num_threads; // default: number of hardware threads
+} utxt_layout_parallel_params;
+
+// Like utxt_layout_add_text with the same result, but paragraphs (separated by '\n') are laid out
+// on multiple threads. Use this for big documents.
+// If the layout can not grow (see utxt_layout_set_growth) or only one thread is used, this is just
+// utxt_layout_add_text.
+size_t utxt_layout_add_text_parallel(utxt_layout* layout, const utxt_font* font, utxt_string text,
+    utxt_layout_parallel_params params);
+
+typedef struct {
+    float width; // of the widest line
+    float height; // sum of the line heights
+    size_t num_lines;
+} utxt_text_size;
+
+// Returns the size text would have if it was added to a freshly reset layout with
+// utxt_layout_add_text, without writing any glyphs or allocating memory (e.g. to size a dialog box
+// before laying out the text into it).
+utxt_text_size utxt_measure_text(const utxt_font* font, utxt_string text, float wrap_width);
+
+// Returns the largest scale in [min_scale, max_scale] (relative to the size the font was loaded
+// with) at which text, laid out with utxt_layout_add_text wrapping at box_width, fits into the box.
+// Returns min_scale if it does not fit at all. This only measures the text with scaled metrics, so
+// you don't need to load the font at every candidate size. The result is exact for fonts that are
+// drawn scaled (e.g. SDF fonts). Fonts loaded again at the resulting size might differ slightly
+// because of pixel snapping, so leave some slack.
+float utxt_fit_text(const utxt_font* font, utxt_string text, float box_width, float box_height,
+    float min_scale, float max_scale);
 // Computes the final positions of all added glyphs (e.g. applies text alignment).
 // It should be called after all text has been added and before getting the layout glyphs.
+// You may add more text after calling this (e.g. to append to a log) and call it again. Lines
+// before the last one will not be touched.
 void utxt_layout_compute(utxt_layout* layout);
 
+// Incremental layout: Text offsets are byte offsets into all text added since the last reset, as
+// if it was concatenated. After an edit at text_offset, call utxt_layout_rewind, which removes
+// everything starting from the first line that might be affected and returns the text offset from
+// which you have to add the text again (followed by utxt_layout_compute).
+// Layout is deterministic from the start of a line, so the result is the same as laying out
+// everything from scratch, but only the lines starting from the edit are computed.
+size_t utxt_layout_rewind(utxt_layout* layout, size_t text_offset);
+
+typedef struct {
+    size_t first_glyph;
+    size_t num_glyphs;
+} utxt_layout_range;
+
+// Returns the range of glyphs that were added or moved since the last call of this function (or
+// the last reset). Glyphs before the range did not change, glyphs after it were removed.
+// Use this to only update (e.g. re-upload) what changed.
+utxt_layout_range utxt_layout_take_changes(utxt_layout* layout);
+
 typedef struct {
     const utxt_glyph* glyph;
     float x, y;
 } utxt_layout_glyph;
 
+typedef struct {
+    size_t first_glyph;
+    size_t num_glyphs;
+    size_t text_offset; // where the line starts in the text (see utxt_layout_rewind)
+    float x; // cursor position before the first glyph (after alignment)
+    float y; // baseline
+    float width; // visual width, from x to the right edge of the last glyph
+    float height; // distance to the next line's baseline
+    float ascent; // maximum ascent of the fonts in this line, the line's box starts at y - ascent
+} utxt_layout_line;
+
+// Returns all lines of the layout, including empty ones, for culling, scrolling and hit-testing.
+// The lines are sorted by y and there is always at least one line.
+// The returned pointer is valid until the next add_*, compute, reset, rewind or free.
+const utxt_layout_line* utxt_layout_get_lines(utxt_layout* layout, size_t* count);
+
 // The returned pointer is valid until the next add_*, compute, reset or free.
 // You get to modify these before turning them into quads, so you can apply text effects that
 // displace glyphs (like wave or shake).
 utxt_layout_glyph* utxt_layout_get_glyphs(utxt_layout* layout, size_t* count);
 
+// Byte offset of every glyph in the text (like the text offsets of utxt_layout_rewind).
+// The returned pointer is valid until the next add_*, compute, reset or free.
+const size_t* utxt_layout_get_glyph_text_offsets(utxt_layout* layout, size_t* count);
+
+// Hit testing (e.g. for mouse picking and caret placement) in O(log n). Lines are found by y and
+// glyphs within a line by x, so this does not consider displaced glyphs (text effects).
+typedef struct {
+    size_t line;
+    size_t glyph; // glyph at or left of the point (or the first one), SIZE_MAX if line is empty
+    size_t caret; // glyph index the caret goes before, up to the end of the line
+    size_t text_offset; // byte offset of the caret in the text
+} utxt_layout_hit;
+
+utxt_layout_hit utxt_layout_hit_test(utxt_layout* layout, float x, float y);
+
+// Returns the cell of a glyph, i.e. its advance and the height of its line (e.g. for selections).
+// Use utxt_layout_hit.glyph with this to check whether the point is actually on the glyph.
+utxt_rect utxt_layout_glyph_rect(utxt_layout* layout, size_t index);
+
 void utxt_layout_glyph_get_quads(
     const utxt_layout_glyph* layout_glyphs, size_t num_glyphs, utxt_quad* quads, float x, float y);
 
+// Like utxt_layout_glyph_get_quads, but only generates quads that are (partially) inside the clip
+// rect. quads must have space for num_glyphs quads. Returns the number of quads generated.
+size_t utxt_layout_glyph_get_quads_clipped(const utxt_layout_glyph* layout_glyphs,
+    size_t num_glyphs, utxt_quad* quads, float x, float y, utxt_rect clip, utxt_clip_mode mode);
+
+// All layout glyphs must belong to the given font, because the instances reference its glyph table.
+void utxt_layout_glyph_get_instances(const utxt_font* font, const utxt_layout_glyph* layout_glyphs,
+    size_t num_glyphs, utxt_glyph_instance* instances, float x, float y);
+
+// Virtualized layout for very large texts (e.g. log files): Only the line breaks of the whole text
+// are computed and stored (a text offset and a y position per line), glyphs are only generated for
+// the lines you want to display. The result is the same as laying out the whole text with
+// utxt_layout_add_text. The text and the font must outlive the virtual layout.
+
+typedef struct utxt_virtual_layout utxt_virtual_layout;
+
+utxt_virtual_layout* utxt_virtual_layout_create(utxt_alloc alloc);
+void utxt_virtual_layout_free(utxt_virtual_layout* layout);
+
+// Computes the line breaks of text. Apart from the line table, the memory used while doing this
+// does not grow with the length of the text.
+void utxt_virtual_layout_set_text(utxt_virtual_layout* layout, const utxt_font* font,
+    utxt_string text, float wrap_width, utxt_text_align align);
+
+size_t utxt_virtual_layout_get_num_lines(const utxt_virtual_layout* layout);
+// Total height of the text. Line positions are doubles, so they stay exact for millions of lines.
+double utxt_virtual_layout_get_height(const utxt_virtual_layout* layout);
+// Baseline of a line, like utxt_layout_line.y.
+double utxt_virtual_layout_get_line_y(const utxt_virtual_layout* layout, size_t line);
+size_t utxt_virtual_layout_get_line_text_offset(const utxt_virtual_layout* layout, size_t line);
+
+// Returns the line at a y position (e.g. the scroll position), clamped to the existing lines.
+// Lines span from their baseline minus the font's ascent to the next line.
+size_t utxt_virtual_layout_find_line(const utxt_virtual_layout* layout, double y);
+// Returns the line containing the byte at text_offset, e.g. to scroll to a search result.
+size_t utxt_virtual_layout_find_text_offset(const utxt_virtual_layout* layout, size_t text_offset);
+
+// Resets layout and lays out the lines [first_line, first_line + num_lines) into it (followed by
+// utxt_layout_compute). Glyph and line positions are relative to the baseline of first_line, so
+// draw them at utxt_virtual_layout_get_line_y(first_line) minus your scroll position. Text offsets
+// in layout are relative to the start of first_line. Returns the number of lines laid out.
+size_t utxt_virtual_layout_materialize(const utxt_virtual_layout* layout, utxt_layout* dst,
+    size_t first_line, size_t num_lines);
+
+// Layout cache for immediate mode UIs, which lay out the same strings every frame: The results of
+// utxt_layout_add_text are cached by font, text, wrap width and alignment. When the memory budget
+// (glyphs and text copies) is exceeded, the least recently used entries are evicted.
+// Fonts must not be freed (or must be cleared from the cache) while their layouts are cached.
+
+typedef struct utxt_layout_cache utxt_layout_cache;
+
+utxt_layout_cache* utxt_layout_cache_create(utxt_alloc alloc, size_t memory_budget);
+void utxt_layout_cache_free(utxt_layout_cache* cache);
+void utxt_layout_cache_clear(utxt_layout_cache* cache);
+
+// Returns the glyphs of text laid out into a freshly reset layout (followed by compute), either
+// from the cache or by laying it out. The returned pointer is valid until the next call of this
+// function, clear or free, so turn the glyphs into quads right away.
+const utxt_layout_glyph* utxt_layout_cache_get(utxt_layout_cache* cache, const utxt_font* font,
+    utxt_string text, float wrap_width, utxt_text_align align, size_t* count);
+
+// CPU rendering: Rasterizes quads into an image in memory using the font's atlas, e.g. for
+// rendering thumbnails or overlays on machines without a GPU.
+
+typedef struct {
+    uint8_t* data;
+    uint32_t width;
+    uint32_t height;
+    uint32_t channels; // 1 or 4 (RGBA)
+    size_t stride; // bytes per row, default: width * channels
+} utxt_image;
+
+typedef struct {
+    uint8_t r, g, b, a;
+} utxt_color;
+
+// Blends the quads (offset by x, y) into the image, using the atlas as coverage.
+// Single channel images accumulate coverage: dst = a + dst * (1 - a), with a = coverage * color.a.
+// RGBA images are blended "over" with premultiplied alpha, so the image must hold premultiplied
+// colors and the result is premultiplied too, e.g. white at 50% coverage over a transparent pixel
+// gives (128, 128, 128, 128). Divide by alpha if you need straight alpha.
+// Quads are snapped to whole pixels. If a quad is larger or smaller than its atlas region (e.g.
+// because of oversampling), the atlas is box filtered. clip may be NULL.
+void utxt_render_quads(utxt_image image, const utxt_font* font, const utxt_quad* quads,
+    size_t num_quads, float x, float y, utxt_color color, const utxt_rect* clip);
+
+// A list of quads (e.g. from utxt_draw_text or utxt_layout_glyph_get_quads) to draw at (x, y).
+typedef struct {
+    const utxt_quad* quads;
+    size_t num_quads;
+    float x, y;
+    utxt_color color;
+} utxt_render_job;
+
+typedef struct {
+    utxt_alloc alloc; // used for temporary allocations
+    uint32_t num_threads; // default: number of hardware threads
+    uint32_t tile_size; // in pixels, default: 64
+} utxt_render_batch_params;
+
+// Renders many jobs (e.g. thousands of labels) into the same image in parallel. The quads are
+// binned into tiles of the image and the tiles are rendered on multiple threads (with one thread,
+// the quads are rendered directly). The result is the same as calling utxt_render_quads for every
+// job in order.
+void utxt_render_batch(utxt_image image, const utxt_font* font, const utxt_render_job* jobs,
+    size_t num_jobs, utxt_render_batch_params params);
+
 #ifdef __cplusplus
 }
 #endif
@@ -1,52 +1,23 @@
 #include "utxt.h"
 
+#include <algorithm>
+#include <bit>
 #include <cassert>
 #include <cmath>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <memory>
+#include <mutex>
 #include <span>
 #include <utility>
 
 #include "stb_truetype.h"
-
-#define EXPORT extern "C"
+#include "utxt_internal.h"
 
 namespace utxt {
-static std::string_view last_error;
-
-static void* realloc(void* ptr, size_t, size_t new_size, void*)
-{
-    if (new_size) {
-        return std::realloc(ptr, new_size);
-    } else {
-        std::free(ptr);
-        return nullptr;
-    }
-}
-
-template <typename T>
-static T* allocate(utxt_alloc alloc, size_t count = 1)
-{
-    auto ptr = (T*)alloc.realloc(nullptr, 0, sizeof(T) * count, alloc.ctx);
-    for (size_t i = 0; i < count; ++i) {
-        new (ptr + i) T {};
-    }
-    return ptr;
-}
-
-template <typename T>
-static void deallocate(utxt_alloc alloc, T* ptr, size_t count = 1)
-{
-    if (!ptr) {
-        return;
-    }
-    for (size_t i = 0; i < count; ++i) {
-        (ptr + i)->~T();
-    }
-    alloc.realloc(ptr, sizeof(T) * count, 0, alloc.ctx);
-}
+// Per thread, so loading a font on one thread does not race with errors on another.
+static thread_local std::string_view last_error;
 
 EXPORT utxt_string utxt_get_last_error()
 {
@@ -77,12 +48,14 @@ static uint8_t* read_file(utxt_alloc alloc, const char* path, size_t* size)
     std::fseek(f, 0, SEEK_END);
     const auto ssize = std::ftell(f);
     if (ssize < 0) {
+        std::fclose(f);
         return nullptr;
     }
     *size = (size_t)ssize;
     std::fseek(f, 0, SEEK_SET);
     auto buf = allocate<uint8_t>(alloc, *size);
     const auto n = std::fread(buf, 1, *size, f);
+    std::fclose(f);
     if (n != *size) {
         deallocate(alloc, buf, *size);
         return nullptr;
@@ -90,22 +63,132 @@ static uint8_t* read_file(utxt_alloc alloc, const char* path, size_t* size)
     return buf;
 }
 
+constexpr uint32_t font_magic = 0x74787475; // "utxt"
+constexpr uint32_t font_version = 2;
+constexpr size_t font_blob_alignment = 16;
+
+// A font is a single contiguous blob: This header, followed by the arrays at the given offsets (in
+// bytes from the start of the header). It contains no pointers, so it can be saved and used
+// directly from memory again (see utxt_font_get_blob and utxt_font_from_blob).
 struct Font {
-    utxt_alloc alloc;
-    uint8_t* atlas_data;
+    uint32_t magic;
+    uint32_t version;
+    uint64_t size; // in bytes, including this header
+    utxt_font_metrics metrics;
     uint32_t atlas_width;
     uint32_t atlas_height;
     uint32_t atlas_channels;
-    utxt_font_metrics metrics;
-    utxt_glyph* glyphs;
-    size_t num_glyphs;
+    uint32_t flags; // font_flag_*
+    uint64_t num_glyphs; // 0 for dynamic fonts, see get_num_glyphs
+    uint64_t num_kerning_pairs;
     // There is a separate array for codepoint -> glyph lookup, because we need to do it A LOT and
-    // it should be fast.
-    uint32_t* glyph_codepoints;
-    utxt_kerning_pair* kerning_pairs;
-    size_t num_kerning_pairs;
+    // it should be fast. It comes first, right after the header.
+    uint64_t glyph_codepoints_offset;
+    uint64_t glyphs_offset;
+    uint64_t kerning_pairs_offset;
+    uint64_t atlas_data_offset; // 0 if there is no atlas
+
+    template <typename T>
+    T* get(uint64_t offset) const
+    {
+        return offset ? (T*)((uint8_t*)this + offset) : nullptr;
+    }
+
+    uint32_t* glyph_codepoints() const { return get<uint32_t>(glyph_codepoints_offset); }
+    utxt_glyph* glyphs() const { return get<utxt_glyph>(glyphs_offset); }
+    utxt_kerning_pair* kerning_pairs() const
+    {
+        return get<utxt_kerning_pair>(kerning_pairs_offset);
+    }
+    uint8_t* atlas_data() const { return get<uint8_t>(atlas_data_offset); }
+};
+
+constexpr uint32_t font_flag_dynamic = 1; // see utxt_font_create_dynamic
+
+// The rest of a dynamic font, which can not be part of the blob.
+struct DynamicFont {
+    stbtt_fontinfo font_info;
+    float scale = 0.0f;
+    // Open addressing hash table from code point to glyph (see make_slot). Slots are only ever
+    // filled, never removed, so finding glyphs that were already added does not lock.
+    std::atomic<uint64_t>* slots = nullptr;
+    size_t num_slots = 0; // power of two
+    std::atomic<size_t> num_slots_used { 0 };
+    size_t max_glyphs = 0; // the font has room for this many glyphs
+    std::atomic<size_t> num_glyphs { 0 };
+    std::atomic<uint64_t> atlas_version { 0 };
+    // Held while a glyph is copied into the atlas and appended to the glyphs.
+    std::mutex mutex;
+    uint32_t pack_x = 0;
+    uint32_t pack_y = 0;
+    uint32_t pack_row_height = 0;
+};
+
+// Fonts created by this library are preceded by the allocator that owns them (and the state of
+// dynamic fonts), which is not part of the blob.
+struct alignas(font_blob_alignment) FontOwner {
+    utxt_alloc alloc;
+    DynamicFont* dynamic;
 };
 
+static DynamicFont* get_dynamic(const Font& font)
+{
+    return (font.flags & font_flag_dynamic) ? ((const FontOwner*)&font - 1)->dynamic : nullptr;
+}
+
+// Dynamic fonts add their glyphs one by one and don't use the sorted glyph_codepoints.
+static size_t get_num_glyphs(const Font& font)
+{
+    const auto dynamic = get_dynamic(font);
+    return dynamic ? dynamic->num_glyphs.load(std::memory_order_acquire) : font.num_glyphs;
+}
+
+static uint64_t append_blob_array(uint64_t& size, size_t count, size_t element_size)
+{
+    if (!count) {
+        return 0;
+    }
+    const auto offset = (size + font_blob_alignment - 1) & ~(uint64_t)(font_blob_alignment - 1);
+    size = offset + count * element_size;
+    return offset;
+}
+
+// Allocates a zero-initialized font with room for the given number of glyphs, kerning pairs and
+// atlas pixels.
+static Font* allocate_font(utxt_alloc alloc, size_t num_glyphs, size_t num_kerning_pairs,
+    uint32_t atlas_width, uint32_t atlas_height, uint32_t atlas_channels)
+{
+    uint64_t size = sizeof(Font);
+    const auto glyph_codepoints_offset = append_blob_array(size, num_glyphs, sizeof(uint32_t));
+    const auto glyphs_offset = append_blob_array(size, num_glyphs, sizeof(utxt_glyph));
+    const auto kerning_pairs_offset
+        = append_blob_array(size, num_kerning_pairs, sizeof(utxt_kerning_pair));
+    const auto atlas_data_offset
+        = append_blob_array(size, (size_t)atlas_width * atlas_height * atlas_channels, 1);
+
+    auto owner = (FontOwner*)alloc.realloc(nullptr, 0, sizeof(FontOwner) + size, alloc.ctx);
+    std::memset(owner, 0, sizeof(FontOwner) + size);
+    owner->alloc = alloc;
+    auto font = (Font*)(owner + 1);
+    *font = {
+        .magic = font_magic,
+        .version = font_version,
+        .size = size,
+        .metrics = {},
+        .atlas_width = atlas_width,
+        .atlas_height = atlas_height,
+        .atlas_channels = atlas_channels,
+        .flags = 0,
+        .num_glyphs = num_glyphs,
+        .num_kerning_pairs = num_kerning_pairs,
+        .glyph_codepoints_offset = glyph_codepoints_offset,
+        .glyphs_offset = glyphs_offset,
+        .kerning_pairs_offset = kerning_pairs_offset,
+        .atlas_data_offset = atlas_data_offset,
+    };
+    return font;
+}
+
 static uint32_t sort_key(uint32_t v)
 {
     return v;
@@ -129,67 +212,83 @@ static bool is_sorted(std::span<const T> values)
     return true;
 }
 
-static uint32_t default_code_point_ranges[4] = {
+static const uint32_t default_code_point_ranges[4] = {
     // clang-format off
     0x20, 0x7f, // Basic Latin
     0xa0, 0xff, // Latin-1 Supplement
     // clang-format on
 };
 
-EXPORT utxt_font* utxt_font_load_ttf_buffer(
-    utxt_alloc alloc, const uint8_t* buffer, size_t, utxt_load_ttf_params params)
+static bool init_font_info(stbtt_fontinfo& font_info, const uint8_t* buffer, uint32_t font_index)
 {
-    if (!alloc.realloc) {
-        alloc = { realloc, nullptr };
-    }
-    if (!params.code_point_ranges) {
-        params.code_point_ranges = default_code_point_ranges;
-        params.num_code_point_ranges = std::size(default_code_point_ranges) / 2;
-    }
-    params.oversampling_h = params.oversampling_h ? params.oversampling_h : 2;
-    params.oversampling_v = params.oversampling_v ? params.oversampling_v : 2;
-
     const auto num_fonts = stbtt_GetNumberOfFonts(buffer);
     if (num_fonts <= 0) {
         last_error = "No fonts in file";
-        return nullptr;
+        return false;
     }
-    if (params.font_index >= (uint32_t)num_fonts) {
+    if (font_index >= (uint32_t)num_fonts) {
         last_error = "Font index out of range";
-        return nullptr;
+        return false;
     }
-    const auto font_offset = stbtt_GetFontOffsetForIndex(buffer, (int)params.font_index);
+    const auto font_offset = stbtt_GetFontOffsetForIndex(buffer, (int)font_index);
     if (font_offset < 0) {
         last_error = "Invalid font index";
-        return nullptr;
+        return false;
     }
-
-    stbtt_fontinfo font_info;
     if (!stbtt_InitFont(&font_info, buffer, font_offset)) {
         last_error = "Could not load font";
-        return nullptr;
+        return false;
     }
+    return true;
+}
+
+static utxt_font_metrics compute_metrics(const stbtt_fontinfo& font_info, float scale)
+{
+    int ascent = 0, descent = 0, line_gap = 0;
+    stbtt_GetFontVMetrics(&font_info, &ascent, &descent, &line_gap);
+    return {
+        .ascent = std::roundf(scale * (float)ascent),
+        .descent = std::roundf(scale * (float)descent),
+        .line_gap = std::roundf(scale * (float)line_gap),
+        .line_height = std::roundf(scale * (float)(ascent - descent + line_gap)),
+    };
+}
 
-    const auto atlas_data_size = params.atlas_size * params.atlas_size;
-    auto atlas_data = allocate<uint8_t>(alloc, atlas_data_size);
-    auto atlas_data_autofree = AutoFree<uint8_t> { alloc, atlas_data, atlas_data_size };
+// Fills in the kerning pairs of font, which must already be allocated.
+static void load_kerning_pairs(
+    utxt_alloc alloc, Font& font, const stbtt_fontinfo& font_info, float scale)
+{
+    if (font.num_kerning_pairs == 0) {
+        return;
+    }
+    auto* table = allocate<stbtt_kerningentry>(alloc, font.num_kerning_pairs);
+    stbtt_GetKerningTable(&font_info, table, (int)font.num_kerning_pairs);
+    for (size_t i = 0; i < font.num_kerning_pairs; ++i) {
+        font.kerning_pairs()[i] = {
+            .first_glyph = (uint32_t)table[i].glyph1,
+            .second_glyph = (uint32_t)table[i].glyph2,
+            .amount = scale * (float)table[i].advance,
+        };
+    }
+    deallocate(alloc, table, font.num_kerning_pairs);
+    // Make sure it's sorted.
+    // Accoring to the docs the table is sorted by glyph1, then glyph2.
+    assert(is_sorted<utxt_kerning_pair>({ font.kerning_pairs(), font.num_kerning_pairs }));
+}
 
+// Packs the glyphs of all code point ranges into the atlas and fills in the glyphs of font, which
+// must already be allocated. The temporary buffers are allocated after the font and freed in
+// reverse order, so an arena (see utxt_arena) can reclaim them.
+static bool pack_glyphs(utxt_alloc alloc, Font& font, const uint8_t* buffer,
+    const stbtt_fontinfo& font_info, const utxt_load_ttf_params& params)
+{
     const auto num_pack_ranges = params.num_code_point_ranges;
     auto pack_ranges = allocate<stbtt_pack_range>(alloc, num_pack_ranges);
     auto pack_ranges_autofree = AutoFree<stbtt_pack_range> { alloc, pack_ranges, num_pack_ranges };
 
-    size_t num_packed_chars = 0;
-    for (size_t i = 0; i < num_pack_ranges; ++i) {
-        const auto cp_first = params.code_point_ranges[i * 2 + 0];
-        const auto cp_last = params.code_point_ranges[i * 2 + 1];
-        // in stb_truetype it seems every codepoint maps to a single glyph and
-        // that there a no multi-codepoint glyphs
-        num_packed_chars += cp_last - cp_first + 1;
-    }
-
-    auto packed_chars = allocate<stbtt_packedchar>(alloc, num_packed_chars);
+    auto packed_chars = allocate<stbtt_packedchar>(alloc, font.num_glyphs);
     auto packed_chars_autofree
-        = AutoFree<stbtt_packedchar> { alloc, packed_chars, num_packed_chars };
+        = AutoFree<stbtt_packedchar> { alloc, packed_chars, font.num_glyphs };
 
     size_t pc_index = 0;
     for (size_t i = 0; i < num_pack_ranges; ++i) {
@@ -210,40 +309,19 @@ EXPORT utxt_font* utxt_font_load_ttf_buffer(
 
     stbtt_pack_context pack_ctx;
     const int padding = 1;
-    if (!stbtt_PackBegin(&pack_ctx, atlas_data, (int)params.atlas_size, (int)params.atlas_size, 0,
-            padding, nullptr)) {
+    if (!stbtt_PackBegin(&pack_ctx, font.atlas_data(), (int)params.atlas_size,
+            (int)params.atlas_size, 0, padding, nullptr)) {
         last_error = "Failed to initialize packing context";
-        return nullptr;
+        return false;
     }
     stbtt_PackSetOversampling(&pack_ctx, params.oversampling_h, params.oversampling_v);
     const auto ret = stbtt_PackFontRanges(
         &pack_ctx, buffer, (int)params.font_index, pack_ranges, (int)num_pack_ranges);
+    stbtt_PackEnd(&pack_ctx);
     if (!ret) {
         last_error = "Failed to pack character bitmaps";
-        return nullptr;
+        return false;
     }
-    stbtt_PackEnd(&pack_ctx);
-
-    // If we got here, we won't fail anymore. Let's create the font object
-    auto font = allocate<Font>(alloc);
-    font->alloc = alloc;
-    font->atlas_data = atlas_data_autofree.release();
-    font->atlas_width = params.atlas_size;
-    font->atlas_height = params.atlas_size;
-    font->atlas_channels = 1;
-
-    const auto scale = stbtt_ScaleForPixelHeight(&font_info, (float)params.size);
-
-    int ascent = 0, descent = 0, line_gap = 0;
-    stbtt_GetFontVMetrics(&font_info, &ascent, &descent, &line_gap);
-    font->metrics.ascent = std::roundf(scale * (float)ascent);
-    font->metrics.descent = std::roundf(scale * (float)descent);
-    font->metrics.line_gap = std::roundf(scale * (float)line_gap);
-    font->metrics.line_height = std::roundf(scale * (float)(ascent - descent + line_gap));
-
-    font->num_glyphs = num_packed_chars;
-    font->glyphs = allocate<utxt_glyph>(alloc, font->num_glyphs);
-    font->glyph_codepoints = allocate<uint32_t>(alloc, font->num_glyphs);
 
     size_t glyph_idx = 0;
     for (size_t i = 0; i < num_pack_ranges; ++i) {
@@ -255,7 +333,7 @@ EXPORT utxt_font* utxt_font_load_ttf_buffer(
             const auto cp = cp_first + i;
             const auto& pc = packed_chars[glyph_idx];
             const auto font_glyph_idx = stbtt_FindGlyphIndex(&font_info, (int)cp);
-            font->glyphs[glyph_idx] = {
+            font.glyphs()[glyph_idx] = {
                 .codepoint = cp,
                 .glyph_index = (uint32_t)font_glyph_idx,
                 .bearing_x = pc.xoff,
@@ -270,31 +348,55 @@ EXPORT utxt_font* utxt_font_load_ttf_buffer(
             };
             // NOTE: glyph index 0 is missing glyph symbols! (TrueType spec)
             // so it is possible we packed the missing glyph for this codepoint
-            font->glyph_codepoints[glyph_idx] = cp;
+            font.glyph_codepoints()[glyph_idx] = cp;
             glyph_idx++;
         }
     }
-    assert(is_sorted<uint32_t>({ font->glyph_codepoints, font->num_glyphs }));
+    assert(is_sorted<uint32_t>({ font.glyph_codepoints(), font.num_glyphs }));
+    return true;
+}
 
-    font->num_kerning_pairs = (size_t)stbtt_GetKerningTableLength(&font_info);
-    font->kerning_pairs = nullptr;
-    if (font->num_kerning_pairs > 0) {
-        font->kerning_pairs = allocate<utxt_kerning_pair>(alloc, font->num_kerning_pairs);
-        auto* table = allocate<stbtt_kerningentry>(alloc, font->num_kerning_pairs);
-        stbtt_GetKerningTable(&font_info, table, (int)font->num_kerning_pairs);
-        for (size_t i = 0; i < font->num_kerning_pairs; ++i) {
-            font->kerning_pairs[i] = {
-                .first_glyph = (uint32_t)table[i].glyph1,
-                .second_glyph = (uint32_t)table[i].glyph2,
-                .amount = scale * (float)table[i].advance,
-            };
-        }
-        deallocate(alloc, table, font->num_kerning_pairs);
-        // Make sure it's sorted.
-        // Accoring to the docs the table is sorted by glyph1, then glyph2.
-        assert(is_sorted<utxt_kerning_pair>({ font->kerning_pairs, font->num_kerning_pairs }));
+EXPORT utxt_font* utxt_font_load_ttf_buffer(
+    utxt_alloc alloc, const uint8_t* buffer, size_t, utxt_load_ttf_params params)
+{
+    if (!alloc.realloc) {
+        alloc = { realloc, nullptr };
+    }
+    if (!params.code_point_ranges) {
+        params.code_point_ranges = default_code_point_ranges;
+        params.num_code_point_ranges = std::size(default_code_point_ranges) / 2;
+    }
+    params.oversampling_h = params.oversampling_h ? params.oversampling_h : 2;
+    params.oversampling_v = params.oversampling_v ? params.oversampling_v : 2;
+
+    stbtt_fontinfo font_info;
+    if (!init_font_info(font_info, buffer, params.font_index)) {
+        return nullptr;
     }
 
+    size_t num_packed_chars = 0;
+    for (size_t i = 0; i < params.num_code_point_ranges; ++i) {
+        const auto cp_first = params.code_point_ranges[i * 2 + 0];
+        const auto cp_last = params.code_point_ranges[i * 2 + 1];
+        // in stb_truetype it seems every codepoint maps to a single glyph and
+        // that there a no multi-codepoint glyphs
+        num_packed_chars += cp_last - cp_first + 1;
+    }
+
+    // All sizes are known now, so the font is allocated before any temporary buffers.
+    const auto num_kerning_pairs = (size_t)stbtt_GetKerningTableLength(&font_info);
+    auto font = allocate_font(
+        alloc, num_packed_chars, num_kerning_pairs, params.atlas_size, params.atlas_size, 1);
+
+    if (!pack_glyphs(alloc, *font, buffer, font_info, params)) {
+        utxt_font_free((utxt_font*)font);
+        return nullptr;
+    }
+
+    const auto scale = stbtt_ScaleForPixelHeight(&font_info, (float)params.size);
+    load_kerning_pairs(alloc, *font, font_info, scale);
+    font->metrics = compute_metrics(font_info, scale);
+
     return (utxt_font*)font;
 }
 
@@ -305,13 +407,16 @@ EXPORT utxt_font* utxt_font_load_ttf(
         alloc = { realloc, nullptr };
     }
 
+    // The file is only needed while loading, but it is allocated before the font, so it would be
+    // stuck below the font in an arena. It is read with the default allocator instead.
+    const utxt_alloc file_alloc = { realloc, nullptr };
     size_t file_size = 0;
-    auto file_data = read_file(alloc, path, &file_size);
+    auto file_data = read_file(file_alloc, path, &file_size);
     if (!file_data) {
         last_error = "Could not read file";
         return nullptr;
     }
-    auto file_data_autofree = AutoFree<uint8_t> { alloc, file_data, file_size };
+    auto file_data_autofree = AutoFree<uint8_t> { file_alloc, file_data, file_size };
 
     return utxt_font_load_ttf_buffer(alloc, file_data, file_size, params);
 }
@@ -322,51 +427,257 @@ EXPORT utxt_font* utxt_font_create(utxt_alloc alloc, utxt_font_create_params par
         alloc = { realloc, nullptr };
     }
 
-    auto font = allocate<Font>(alloc);
-    font->alloc = alloc;
-
-    if (params.atlas_data) {
-        font->atlas_width = params.atlas_width;
-        font->atlas_height = params.atlas_height;
-        font->atlas_channels = params.atlas_channels ? params.atlas_channels : 1;
-        const auto atlas_size_bytes = font->atlas_width * font->atlas_height * font->atlas_channels;
-        font->atlas_data = allocate<uint8_t>(alloc, atlas_size_bytes);
-        std::memcpy(font->atlas_data, params.atlas_data, atlas_size_bytes);
+    assert(params.glyphs);
+    const auto num_kerning_pairs = params.kerning_pairs ? params.num_kerning_pairs : 0;
+    const auto atlas_width = params.atlas_data ? params.atlas_width : 0;
+    const auto atlas_height = params.atlas_data ? params.atlas_height : 0;
+    const auto atlas_channels
+        = params.atlas_data ? (params.atlas_channels ? params.atlas_channels : 1) : 0;
+    auto font = allocate_font(
+        alloc, params.num_glyphs, num_kerning_pairs, atlas_width, atlas_height, atlas_channels);
+
+    if (font->atlas_data_offset) {
+        std::memcpy(font->atlas_data(), params.atlas_data,
+            (size_t)atlas_width * atlas_height * atlas_channels);
     }
 
     font->metrics = params.metrics;
 
-    assert(params.glyphs);
-    font->num_glyphs = params.num_glyphs;
-    font->glyphs = allocate<utxt_glyph>(alloc, font->num_glyphs);
-    std::memcpy(font->glyphs, params.glyphs, font->num_glyphs * sizeof(utxt_glyph));
-
-    font->glyph_codepoints = allocate<uint32_t>(alloc, font->num_glyphs);
+    std::memcpy(font->glyphs(), params.glyphs, font->num_glyphs * sizeof(utxt_glyph));
     for (size_t i = 0; i < font->num_glyphs; ++i) {
-        font->glyph_codepoints[i] = font->glyphs[i].codepoint;
+        font->glyph_codepoints()[i] = font->glyphs()[i].codepoint;
+    }
+    assert(is_sorted<uint32_t>({ font->glyph_codepoints(), font->num_glyphs }));
+
+    if (num_kerning_pairs) {
+        std::memcpy(font->kerning_pairs(), params.kerning_pairs,
+            num_kerning_pairs * sizeof(utxt_kerning_pair));
+        assert(is_sorted<utxt_kerning_pair>({ font->kerning_pairs(), num_kerning_pairs }));
+    }
+
+    return (utxt_font*)font;
+}
+
+EXPORT utxt_font* utxt_font_create_dynamic(
+    utxt_alloc alloc, const uint8_t* buffer, size_t, utxt_dynamic_font_params params)
+{
+    if (!alloc.realloc) {
+        alloc = { realloc, nullptr };
     }
-    assert(is_sorted<uint32_t>({ font->glyph_codepoints, font->num_glyphs }));
+    params.atlas_size = params.atlas_size ? params.atlas_size : 1024;
+    params.max_glyphs = params.max_glyphs ? params.max_glyphs : 1024;
 
-    if (params.kerning_pairs) {
-        font->num_kerning_pairs = params.num_kerning_pairs;
-        font->kerning_pairs = allocate<utxt_kerning_pair>(alloc, font->num_kerning_pairs);
-        std::memcpy(font->kerning_pairs, params.kerning_pairs,
-            font->num_kerning_pairs * sizeof(utxt_kerning_pair));
-        assert(is_sorted<utxt_kerning_pair>({ font->kerning_pairs, font->num_kerning_pairs }));
+    stbtt_fontinfo font_info;
+    if (!init_font_info(font_info, buffer, params.font_index)) {
+        return nullptr;
     }
 
+    const auto num_kerning_pairs = (size_t)stbtt_GetKerningTableLength(&font_info);
+    auto font = allocate_font(
+        alloc, params.max_glyphs, num_kerning_pairs, params.atlas_size, params.atlas_size, 1);
+    font->flags = font_flag_dynamic;
+    font->num_glyphs = 0;
+    const auto scale = stbtt_ScaleForPixelHeight(&font_info, params.size);
+    load_kerning_pairs(alloc, *font, font_info, scale);
+    font->metrics = compute_metrics(font_info, scale);
+
+    auto dynamic = allocate<DynamicFont>(alloc);
+    dynamic->font_info = font_info;
+    dynamic->scale = scale;
+    dynamic->max_glyphs = params.max_glyphs;
+    // Code points without a glyph take up slots too, so leave room for as many of them.
+    dynamic->num_slots = std::bit_ceil((size_t)params.max_glyphs * 4);
+    dynamic->slots = allocate<std::atomic<uint64_t>>(alloc, dynamic->num_slots);
+    ((FontOwner*)font - 1)->dynamic = dynamic;
     return (utxt_font*)font;
 }
 
+// A slot holds (code point + 1) << 32 | state, where the state is the index of the glyph or one of
+// these. 0 is an empty slot.
+constexpr uint32_t slot_pending = UINT32_MAX; // the glyph is being added by another thread
+constexpr uint32_t slot_missing = UINT32_MAX - 1; // the glyph could not be added
+
+static uint64_t make_slot(uint32_t cp, uint32_t state)
+{
+    return ((uint64_t)(cp + 1) << 32) | state;
+}
+
+// Finds a place for a w * h rectangle in the atlas, row by row. Must hold the mutex.
+static bool pack_rect(const Font& font, DynamicFont& dynamic, uint32_t w, uint32_t h, uint32_t* x,
+    uint32_t* y)
+{
+    const uint32_t padding = 1;
+    if (dynamic.pack_x + w > font.atlas_width) {
+        dynamic.pack_x = 0;
+        dynamic.pack_y += dynamic.pack_row_height + padding;
+        dynamic.pack_row_height = 0;
+    }
+    if (w > font.atlas_width || dynamic.pack_y + h > font.atlas_height) {
+        return false;
+    }
+    *x = dynamic.pack_x;
+    *y = dynamic.pack_y;
+    dynamic.pack_x += w + padding;
+    dynamic.pack_row_height = std::max(dynamic.pack_row_height, h);
+    return true;
+}
+
+// Rasterizes the glyph for cp and adds it to the font. Returns the state for its slot.
+static uint32_t add_dynamic_glyph(Font& font, DynamicFont& dynamic, uint32_t cp)
+{
+    const auto& font_info = dynamic.font_info;
+    const auto glyph_index = stbtt_FindGlyphIndex(&font_info, (int)cp);
+    if (!glyph_index) {
+        return slot_missing;
+    }
+    int advance = 0, lsb = 0;
+    stbtt_GetGlyphHMetrics(&font_info, glyph_index, &advance, &lsb);
+    int x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+    stbtt_GetGlyphBitmapBox(
+        &font_info, glyph_index, dynamic.scale, dynamic.scale, &x0, &y0, &x1, &y1);
+    const auto w = (uint32_t)(x1 - x0);
+    const auto h = (uint32_t)(y1 - y0);
+
+    // Rasterize before locking, so other threads can rasterize other glyphs at the same time
+    const auto alloc = ((FontOwner*)&font - 1)->alloc;
+    const auto bitmap_size = (size_t)w * h;
+    auto bitmap = allocate<uint8_t>(alloc, bitmap_size);
+    auto bitmap_autofree = AutoFree<uint8_t> { alloc, bitmap, bitmap_size };
+    if (bitmap_size) {
+        stbtt_MakeGlyphBitmap(
+            &font_info, bitmap, (int)w, (int)h, (int)w, dynamic.scale, dynamic.scale, glyph_index);
+    }
+
+    std::lock_guard lock(dynamic.mutex);
+    const auto index = dynamic.num_glyphs.load(std::memory_order_relaxed);
+    uint32_t x = 0, y = 0;
+    if (index >= dynamic.max_glyphs || (bitmap_size && !pack_rect(font, dynamic, w, h, &x, &y))) {
+        return slot_missing;
+    }
+    for (uint32_t row = 0; row < h; ++row) {
+        const auto dst = font.atlas_data() + (size_t)(y + row) * font.atlas_width + x;
+        std::memcpy(dst, bitmap + row * w, w);
+    }
+    const auto atlas_w = (float)font.atlas_width;
+    const auto atlas_h = (float)font.atlas_height;
+    font.glyphs()[index] = {
+        .codepoint = cp,
+        .glyph_index = (uint32_t)glyph_index,
+        .bearing_x = (float)x0,
+        .bearing_y = (float)y0,
+        .width = (float)w,
+        .height = (float)h,
+        .advance = dynamic.scale * (float)advance,
+        .u0 = (float)x / atlas_w,
+        .v0 = (float)y / atlas_h,
+        .u1 = (float)(x + w) / atlas_w,
+        .v1 = (float)(y + h) / atlas_h,
+    };
+    font.glyph_codepoints()[index] = cp;
+    dynamic.num_glyphs.store(index + 1, std::memory_order_release);
+    if (bitmap_size) {
+        dynamic.atlas_version.fetch_add(1, std::memory_order_release);
+    }
+    return (uint32_t)index;
+}
+
+// Finding a glyph that was added already only takes atomic loads. The first thread that misses a
+// code point claims its slot and adds the glyph, other threads that miss the same code point in the
+// meantime wait for it instead of adding it again.
+// Not inlined, so find_glyph stays small enough to be inlined itself.
+UTXT_NOINLINE static utxt_glyph* find_dynamic_glyph(Font& font, uint32_t cp)
+{
+    auto& dynamic = *get_dynamic(font);
+    const auto mask = dynamic.num_slots - 1;
+    for (auto i = (size_t)(cp * 0x9e3779b1u) & mask;; i = (i + 1) & mask) {
+        auto& slot = dynamic.slots[i];
+        auto value = slot.load(std::memory_order_acquire);
+        if (!value) {
+            // At most half of the slots are used, so probing stays short and always terminates.
+            if (dynamic.num_slots_used.fetch_add(1, std::memory_order_relaxed)
+                >= dynamic.num_slots / 2) {
+                dynamic.num_slots_used.fetch_sub(1, std::memory_order_relaxed);
+                return nullptr;
+            }
+            if (slot.compare_exchange_strong(value, make_slot(cp, slot_pending),
+                    std::memory_order_acquire, std::memory_order_acquire)) {
+                value = make_slot(cp, add_dynamic_glyph(font, dynamic, cp));
+                slot.store(value, std::memory_order_release);
+                slot.notify_all();
+            } else {
+                dynamic.num_slots_used.fetch_sub(1, std::memory_order_relaxed);
+            }
+        }
+        if ((value >> 32) != (uint64_t)cp + 1) {
+            continue;
+        }
+        while ((uint32_t)value == slot_pending) {
+            slot.wait(value, std::memory_order_acquire);
+            value = slot.load(std::memory_order_acquire);
+        }
+        const auto state = (uint32_t)value;
+        return state == slot_missing ? nullptr : &font.glyphs()[state];
+    }
+}
+
 EXPORT void utxt_font_free(utxt_font* font)
 {
     auto fnt = (Font*)font;
-    const auto atlas_data_size = fnt->atlas_width * fnt->atlas_height * fnt->atlas_channels;
-    deallocate(fnt->alloc, fnt->atlas_data, atlas_data_size);
-    deallocate(fnt->alloc, fnt->glyphs, fnt->num_glyphs);
-    deallocate(fnt->alloc, fnt->glyph_codepoints, fnt->num_glyphs);
-    deallocate(fnt->alloc, fnt->kerning_pairs, fnt->num_kerning_pairs);
-    deallocate(fnt->alloc, fnt);
+    auto owner = (FontOwner*)fnt - 1;
+    if (auto dynamic = owner->dynamic) {
+        deallocate(owner->alloc, dynamic->slots, dynamic->num_slots);
+        deallocate(owner->alloc, dynamic);
+    }
+    owner->alloc.realloc(owner, sizeof(FontOwner) + fnt->size, 0, owner->alloc.ctx);
+}
+
+EXPORT const void* utxt_font_get_blob(const utxt_font* font, size_t* size)
+{
+    auto& fnt = *(const Font*)font;
+    *size = fnt.size;
+    return &fnt;
+}
+
+static bool is_valid_blob_array(const Font& font, uint64_t offset, uint64_t count, size_t size)
+{
+    if (!offset) {
+        return count == 0;
+    }
+    return offset >= sizeof(Font) && offset % font_blob_alignment == 0 && offset <= font.size
+        && count <= (font.size - offset) / size;
+}
+
+EXPORT const utxt_font* utxt_font_from_blob(const void* data, size_t size)
+{
+    if ((uintptr_t)data % alignof(Font) != 0 || size < sizeof(Font)) {
+        last_error = "Invalid font blob";
+        return nullptr;
+    }
+    auto& font = *(const Font*)data;
+    if (font.magic != font_magic) {
+        last_error = "Invalid font blob";
+        return nullptr;
+    }
+    if (font.version != font_version) {
+        last_error = "Unsupported font blob version";
+        return nullptr;
+    }
+    if (font.flags & font_flag_dynamic) {
+        last_error = "Dynamic fonts can not be used as blobs";
+        return nullptr;
+    }
+    const auto atlas_size = (uint64_t)font.atlas_width * font.atlas_height;
+    if (font.size > size || font.atlas_channels > 4
+        || !is_valid_blob_array(font, font.glyph_codepoints_offset, font.num_glyphs, 4)
+        || !is_valid_blob_array(font, font.glyphs_offset, font.num_glyphs, sizeof(utxt_glyph))
+        || !is_valid_blob_array(font, font.kerning_pairs_offset, font.num_kerning_pairs,
+            sizeof(utxt_kerning_pair))
+        || !is_valid_blob_array(
+            font, font.atlas_data_offset, atlas_size, std::max(font.atlas_channels, 1u))) {
+        last_error = "Invalid font blob";
+        return nullptr;
+    }
+    return (const utxt_font*)data;
 }
 
 EXPORT const uint8_t* utxt_get_atlas(
@@ -376,7 +687,29 @@ EXPORT const uint8_t* utxt_get_atlas(
     *width = fnt.atlas_width;
     *height = fnt.atlas_height;
     *channels = fnt.atlas_channels;
-    return fnt.atlas_data;
+    return fnt.atlas_data();
+}
+
+EXPORT uint64_t utxt_get_atlas_version(const utxt_font* font)
+{
+    const auto dynamic = get_dynamic(*(const Font*)font);
+    return dynamic ? dynamic->atlas_version.load(std::memory_order_acquire) : 0;
+}
+
+EXPORT uint64_t utxt_copy_atlas(const utxt_font* font, uint8_t* dst)
+{
+    auto& fnt = *(const Font*)font;
+    const auto size = (size_t)fnt.atlas_width * fnt.atlas_height * fnt.atlas_channels;
+    const auto dynamic = get_dynamic(fnt);
+    if (!dynamic) {
+        if (size) {
+            std::memcpy(dst, fnt.atlas_data(), size);
+        }
+        return 0;
+    }
+    std::lock_guard lock(dynamic->mutex);
+    std::memcpy(dst, fnt.atlas_data(), size);
+    return dynamic->atlas_version.load(std::memory_order_relaxed);
 }
 
 EXPORT const utxt_font_metrics* utxt_get_font_metrics(const utxt_font* font)
@@ -388,8 +721,8 @@ EXPORT const utxt_font_metrics* utxt_get_font_metrics(const utxt_font* font)
 EXPORT const utxt_glyph* utxt_get_glyphs(const utxt_font* font, size_t* count)
 {
     auto& fnt = *(Font*)font;
-    *count = fnt.num_glyphs;
-    return fnt.glyphs;
+    *count = get_num_glyphs(fnt);
+    return fnt.glyphs();
 }
 
 // https://hiandrewquinn.github.io/til-site/posts/binary-search-isn-t-about-search/
@@ -424,14 +757,15 @@ static size_t binary_search(std::span<const T> haystack, const T& needle)
 
 static utxt_glyph* find_glyph(Font& font, uint32_t cp)
 {
-    const auto idx = binary_search<uint32_t>({ font.glyph_codepoints, font.num_glyphs }, cp);
+    const auto idx = binary_search<uint32_t>({ font.glyph_codepoints(), font.num_glyphs }, cp);
     if (idx >= font.num_glyphs) {
-        return nullptr;
+        // Dynamic fonts have no sorted glyphs, so we only get here for them or for missing glyphs
+        return (font.flags & font_flag_dynamic) ? find_dynamic_glyph(font, cp) : nullptr;
     }
-    return &font.glyphs[idx];
+    return &font.glyphs()[idx];
 }
 
-const utxt_glyph* utxt_find_glyph(const utxt_font* font, uint32_t codepoint)
+EXPORT const utxt_glyph* utxt_find_glyph(const utxt_font* font, uint32_t codepoint)
 {
     auto& fnt = *(Font*)font;
     return find_glyph(fnt, codepoint);
@@ -441,20 +775,21 @@ EXPORT const utxt_kerning_pair* utxt_get_kerning_pairs(const utxt_font* font, si
 {
     auto& fnt = *(Font*)font;
     *count = fnt.num_kerning_pairs;
-    return fnt.kerning_pairs;
+    return fnt.kerning_pairs();
 }
 
 EXPORT float utxt_get_kerning(const utxt_font* font, uint32_t first_glyph, uint32_t second_glyph)
 {
     auto& fnt = *(Font*)font;
     const auto idx = binary_search<utxt_kerning_pair>(
-        { fnt.kerning_pairs, fnt.num_kerning_pairs }, { first_glyph, second_glyph });
+        { fnt.kerning_pairs(), fnt.num_kerning_pairs }, { first_glyph, second_glyph });
     if (idx >= fnt.num_kerning_pairs) {
         return 0.0f;
     }
-    return fnt.kerning_pairs[idx].amount;
+    return fnt.kerning_pairs()[idx].amount;
 }
 
+// Returns 0 for invalid sequences, of which it skips the first byte.
 static uint32_t decode_utf8(utxt_string& s)
 {
     if (s.len == 0) {
@@ -467,24 +802,38 @@ static uint32_t decode_utf8(utxt_string& s)
         s = { s.data + 1, s.len - 1 };
         return u[0];
     } else if ((u[0] & 0xE0u) == 0xC0) { // 2-byte sequence
-        if (s.len < 2 || (u[1] & 0xC0u) != 0x80)
-            return 0;
-        s = { s.data + 2, s.len - 2 };
-        return ((u[0] & 0x1Fu) << 6) | (u[1] & 0x3Fu);
+        if (s.len >= 2 && (u[1] & 0xC0u) == 0x80) {
+            s = { s.data + 2, s.len - 2 };
+            return ((u[0] & 0x1Fu) << 6) | (u[1] & 0x3Fu);
+        }
     } else if ((u[0] & 0xF0u) == 0xE0) { // 3-byte sequence
-        if (s.len < 3 || (u[1] & 0xC0u) != 0x80 || (u[2] & 0xC0u) != 0x80)
-            return 0;
-        s = { s.data + 3, s.len - 3 };
-        return ((u[0] & 0x0Fu) << 12) | ((u[1] & 0x3Fu) << 6) | (u[2] & 0x3Fu);
+        if (s.len >= 3 && (u[1] & 0xC0u) == 0x80 && (u[2] & 0xC0u) == 0x80) {
+            s = { s.data + 3, s.len - 3 };
+            return ((u[0] & 0x0Fu) << 12) | ((u[1] & 0x3Fu) << 6) | (u[2] & 0x3Fu);
+        }
     } else if ((u[0] & 0xF8u) == 0xF0) { // 4-byte sequence
-        if (s.len < 4 || (u[1] & 0xC0u) != 0x80 || (u[2] & 0xC0u) != 0x80 || (u[3] & 0xC0u) != 0x80)
-            return 0;
-        s = { s.data + 4, s.len - 4 };
-        return ((u[0] & 0x07u) << 18) | ((u[1] & 0x3Fu) << 12) | ((u[2] & 0x3Fu) << 6)
-            | (u[3] & 0x3Fu);
-    } else {
-        return 0; // Invalid start byte
+        if (s.len >= 4 && (u[1] & 0xC0u) == 0x80 && (u[2] & 0xC0u) == 0x80
+            && (u[3] & 0xC0u) == 0x80) {
+            s = { s.data + 4, s.len - 4 };
+            return ((u[0] & 0x07u) << 18) | ((u[1] & 0x3Fu) << 12) | ((u[2] & 0x3Fu) << 6)
+                | (u[3] & 0x3Fu);
+        }
     }
+
+    // Invalid start byte or truncated sequence. Skipping it makes sure we always make progress.
+    s = { s.data + 1, s.len - 1 };
+    return 0;
+}
+
+// Number of bytes decode_utf8 consumed for cp
+static size_t utf8_length(uint32_t cp)
+{
+    return cp < 0x80 ? 1 : cp < 0x800 ? 2 : cp < 0x10000 ? 3 : 4;
+}
+
+static bool is_whitespace(uint32_t cp)
+{
+    return cp == ' ' || cp == '\n' || cp == '\r';
 }
 
 static utxt_glyph* decode_glyph(Font& font, utxt_string& s)
@@ -536,41 +885,255 @@ EXPORT float utxt_get_text_width(const utxt_font* font, utxt_string text)
     return end - start;
 }
 
-static size_t count_quads(const utxt_font* font, utxt_string string)
-{
-    auto& fnt = *(Font*)font;
-
-    size_t quad_count = 0;
+// Lookup tables shared by all texts of a utxt_get_text_widths call, so ASCII text needs neither
+// decoding nor binary searches.
+struct AsciiTables {
+    const utxt_glyph* glyphs[128];
+    float* kerning; // for pairs of printable ASCII characters, nullptr if not worth building
+};
 
-    while (string.len) {
-        const auto glyph = decode_glyph(fnt, string);
-        if (!glyph) {
-            continue;
-        }
-        quad_count++;
-    }
+constexpr uint32_t ascii_printable_first = 0x20;
+constexpr uint32_t ascii_printable_count = 0x7f - ascii_printable_first;
+// Building the kerning table does a binary search for every pair, so it only pays off for big
+// batches
+constexpr size_t ascii_kerning_min_text_len = 64 * 1024;
 
-    return quad_count;
+static bool is_ascii_printable(uint32_t c)
+{
+    return c - ascii_printable_first < ascii_printable_count;
 }
 
-EXPORT size_t utxt_draw_text_batch(
-    utxt_quad* quads, size_t num_quads, const utxt_font* font, utxt_draw_text_state* state, float y)
+// Same as utxt_get_text_width (with identical results), using the tables for ASCII.
+static float get_text_width_ascii(Font& font, const AsciiTables& tables, utxt_string text)
 {
-    auto& fnt = *(Font*)font;
+    float cursor = 0.0f;
+    const utxt_glyph* prev = nullptr; // for kerning
+    uint32_t prev_char = 0;
+    const utxt_glyph* first = nullptr;
+    const utxt_glyph* last = nullptr;
 
-    if (!quads) {
-        return count_quads(font, state->text);
-    }
+    auto add_glyph = [&](const utxt_glyph* glyph, uint32_t c) {
+        if (!glyph) {
+            // code point invalid or not in font, skip and reset kerning
+            prev = nullptr;
+            return;
+        }
+        if (prev && prev->glyph_index) {
+            if (tables.kerning && is_ascii_printable(prev_char) && is_ascii_printable(c)) {
+                cursor += tables.kerning[(prev_char - ascii_printable_first) * ascii_printable_count
+                    + (c - ascii_printable_first)];
+            } else {
+                cursor += utxt_get_kerning(
+                    (utxt_font*)&font, prev->glyph_index, glyph->glyph_index);
+            }
+        }
+        if (!first) {
+            first = glyph;
+        }
+        last = glyph;
+        cursor += glyph->advance;
+        prev = glyph;
+        prev_char = c;
+    };
+
+    while (text.len) {
+#ifdef UTXT_SSE2
+        // Whole blocks of ASCII skip the per-byte check
+        if (text.len >= 16) {
+            const auto block = _mm_loadu_si128((const __m128i*)text.data);
+            if (_mm_movemask_epi8(block) == 0) {
+                for (size_t i = 0; i < 16; ++i) {
+                    const auto c = (uint8_t)text.data[i];
+                    add_glyph(tables.glyphs[c], c);
+                }
+                text = { text.data + 16, text.len - 16 };
+                continue;
+            }
+        }
+#endif
+        const auto c = (uint8_t)text.data[0];
+        if (c < 0x80) {
+            add_glyph(tables.glyphs[c], c);
+            text = { text.data + 1, text.len - 1 };
+        } else {
+            add_glyph(decode_glyph(font, text), 0);
+        }
+    }
+
+    if (!first) {
+        return 0.0f;
+    }
+
+    const auto start = first->bearing_x;
+    const auto end = cursor - last->advance + last->bearing_x + last->width;
+
+    return end - start;
+}
+
+// Texts are handed out to threads in groups of this size
+constexpr size_t text_widths_group_size = 256;
+
+EXPORT void utxt_get_text_widths(const utxt_font* font, const utxt_string* texts, float* widths,
+    size_t count, utxt_text_widths_params params)
+{
+    auto& fnt = *(Font*)font;
+    if (!params.alloc.realloc) {
+        params.alloc = { realloc, nullptr };
+    }
+    // Unlike elsewhere, threads are opt-in here (0 would mean all hardware threads to parallel_for)
+    if (!params.num_threads) {
+        params.num_threads = 1;
+    }
+    const auto num_groups = (count + text_widths_group_size - 1) / text_widths_group_size;
+
+    // Building the tables would add every ASCII glyph to a dynamic font, so only the glyphs that
+    // are actually used are looked up.
+    if (get_dynamic(fnt)) {
+        parallel_for(params.alloc, params.num_threads, num_groups, [&](size_t group) {
+            const auto end = std::min((group + 1) * text_widths_group_size, count);
+            for (auto i = group * text_widths_group_size; i < end; ++i) {
+                widths[i] = utxt_get_text_width(font, texts[i]);
+            }
+        });
+        return;
+    }
+
+    AsciiTables tables;
+    tables.glyphs[0] = nullptr; // decode_glyph treats 0 as invalid
+    for (uint32_t c = 1; c < 128; ++c) {
+        tables.glyphs[c] = find_glyph(fnt, c);
+    }
+
+    size_t total_len = 0;
+    for (size_t i = 0; i < count; ++i) {
+        total_len += texts[i].len;
+    }
+    tables.kerning = nullptr;
+    const auto kerning_size = (size_t)ascii_printable_count * ascii_printable_count;
+    if (fnt.num_kerning_pairs && total_len >= ascii_kerning_min_text_len) {
+        tables.kerning = allocate<float>(params.alloc, kerning_size);
+        for (uint32_t a = 0; a < ascii_printable_count; ++a) {
+            for (uint32_t b = 0; b < ascii_printable_count; ++b) {
+                const auto ga = tables.glyphs[ascii_printable_first + a];
+                const auto gb = tables.glyphs[ascii_printable_first + b];
+                tables.kerning[a * ascii_printable_count + b] = ga && gb
+                    ? utxt_get_kerning(font, ga->glyph_index, gb->glyph_index)
+                    : 0.0f;
+            }
+        }
+    }
+
+    parallel_for(params.alloc, params.num_threads, num_groups, [&](size_t group) {
+        const auto end = std::min((group + 1) * text_widths_group_size, count);
+        for (auto i = group * text_widths_group_size; i < end; ++i) {
+            widths[i] = get_text_width_ascii(fnt, tables, texts[i]);
+        }
+    });
+
+    deallocate(params.alloc, tables.kerning, kerning_size);
+}
+
+EXPORT size_t utxt_get_glyph_positions(utxt_glyph_position* positions, size_t num_positions,
+    const utxt_font* font, utxt_string text)
+{
+    auto& fnt = *(Font*)font;
+
+    const auto text_begin = text.data;
+    float cursor = 0.0f;
+    uint32_t prev_glyph_idx = 0; // for kerning
+    size_t count = 0;
+
+    while (text.len) {
+        const auto text_offset = (size_t)(text.data - text_begin);
+        const auto glyph = decode_glyph(fnt, text);
+        if (!glyph) {
+            // code point invalid or not in font, skip and reset kerning
+            prev_glyph_idx = 0;
+            continue;
+        }
+
+        if (prev_glyph_idx) {
+            cursor += utxt_get_kerning(font, prev_glyph_idx, glyph->glyph_index);
+        }
+        prev_glyph_idx = glyph->glyph_index;
+
+        if (positions) {
+            if (count == num_positions) {
+                return num_positions + 1;
+            }
+            const auto x0 = cursor + glyph->bearing_x;
+            positions[count] = { glyph, text_offset, cursor, x0, x0 + glyph->width };
+        }
+        count++;
+        cursor += glyph->advance;
+    }
+
+    return count;
+}
+
+EXPORT float utxt_glyph_positions_get_advance(
+    const utxt_glyph_position* positions, size_t first, size_t end)
+{
+    if (end <= first) {
+        return 0.0f;
+    }
+    const auto& last = positions[end - 1];
+    return last.x + last.glyph->advance - positions[first].x;
+}
+
+EXPORT float utxt_glyph_positions_get_width(
+    const utxt_glyph_position* positions, size_t first, size_t end)
+{
+    if (end <= first) {
+        return 0.0f;
+    }
+    return positions[end - 1].x1 - positions[first].x0;
+}
+
+EXPORT size_t utxt_glyph_positions_find(
+    const utxt_glyph_position* positions, size_t count, float x)
+{
+    const auto glyphs = std::span { positions, count };
+    return (size_t)(std::partition_point(glyphs.begin(), glyphs.end(),
+                        [x](const utxt_glyph_position& p) {
+                            return p.x + p.glyph->advance / 2.0f <= x;
+                        })
+        - glyphs.begin());
+}
+
+static size_t count_quads(const utxt_font* font, utxt_string string)
+{
+    auto& fnt = *(Font*)font;
+
+    size_t quad_count = 0;
+
+    while (string.len) {
+        const auto glyph = decode_glyph(fnt, string);
+        if (!glyph) {
+            continue;
+        }
+        quad_count++;
+    }
 
-    size_t quad_idx = 0;
+    return quad_count;
+}
+
+// Turns text into glyphs positioned on a single line and calls emit(idx, glyph, x, y) for each,
+// with (x, y) being the top-left corner of the glyph's quad. emit returns whether it used up an
+// output slot (it may skip glyphs). Stops if max_count slots were used.
+template <typename Emit>
+static size_t draw_text(
+    Font& font, utxt_draw_text_state* state, float y, size_t max_count, Emit&& emit)
+{
+    size_t count = 0;
     // state->kerning_state is previous glyph index
 
     while (state->text.len) {
-        if (quad_idx >= num_quads) {
-            return quad_idx;
+        if (count >= max_count) {
+            return count;
         }
 
-        const auto glyph = decode_glyph(fnt, state->text);
+        const auto glyph = decode_glyph(font, state->text);
         if (!glyph) {
             // code point invalid or not in font, skip and reset kerning
             state->kerning_state = 0;
@@ -578,20 +1141,36 @@ EXPORT size_t utxt_draw_text_batch(
         }
 
         if (state->kerning_state) {
-            state->cursor_x += utxt_get_kerning(font, state->kerning_state, glyph->glyph_index);
+            state->cursor_x += utxt_get_kerning(
+                (utxt_font*)&font, state->kerning_state, glyph->glyph_index);
         }
 
-        const auto qx = state->cursor_x + glyph->bearing_x;
-        const auto qy = y + glyph->bearing_y;
-
-        quads[quad_idx++]
-            = { qx, qy, glyph->width, glyph->height, glyph->u0, glyph->v0, glyph->u1, glyph->v1 };
+        if (emit(count, *glyph, state->cursor_x + glyph->bearing_x, y + glyph->bearing_y)) {
+            count++;
+        }
 
         state->cursor_x += glyph->advance;
         state->kerning_state = glyph->glyph_index;
     }
 
-    return quad_idx;
+    return count;
+}
+
+EXPORT size_t utxt_draw_text_batch(
+    utxt_quad* quads, size_t num_quads, const utxt_font* font, utxt_draw_text_state* state, float y)
+{
+    auto& fnt = *(Font*)font;
+
+    if (!quads) {
+        return count_quads(font, state->text);
+    }
+
+    return draw_text(fnt, state, y, num_quads,
+        [quads](size_t idx, const utxt_glyph& glyph, float qx, float qy) {
+            quads[idx]
+                = { qx, qy, glyph.width, glyph.height, glyph.u0, glyph.v0, glyph.u1, glyph.v1 };
+            return true;
+        });
 }
 
 EXPORT size_t utxt_draw_text(
@@ -605,9 +1184,289 @@ EXPORT size_t utxt_draw_text(
     return n;
 }
 
+EXPORT size_t utxt_truncate_text(utxt_quad* quads, size_t num_quads, const utxt_font* font,
+    utxt_string text, float x, float y, float max_width, utxt_string ellipsis)
+{
+    auto& fnt = *(Font*)font;
+
+    // Right edge of the ellipsis relative to where it starts
+    float ellipsis_right = 0.0f;
+    utxt_draw_text_state es { ellipsis, 0.0f, 0 };
+    draw_text(fnt, &es, 0.0f, SIZE_MAX, [&](size_t, const utxt_glyph& glyph, float qx, float) {
+        ellipsis_right = std::fmax(ellipsis_right, qx + glyph.width);
+        return false;
+    });
+
+    // We emit the glyphs while looking for the last one after which the ellipsis still fits. Once
+    // a glyph does not fit, we stop and put the ellipsis after that one.
+    float cursor = 0.0f;
+    uint32_t prev_glyph_idx = 0; // for kerning
+    float left = 0.0f;
+    size_t count = 0;
+    size_t cut = 0;
+    float cut_cursor = 0.0f;
+    bool truncated = false;
+    while (text.len) {
+        const auto glyph = decode_glyph(fnt, text);
+        if (!glyph) {
+            // code point invalid or not in font, skip and reset kerning
+            prev_glyph_idx = 0;
+            continue;
+        }
+
+        if (prev_glyph_idx) {
+            cursor += utxt_get_kerning(font, prev_glyph_idx, glyph->glyph_index);
+        }
+        prev_glyph_idx = glyph->glyph_index;
+
+        const auto qx = cursor + glyph->bearing_x;
+        if (count == 0) {
+            left = qx;
+        }
+        if (qx + glyph->width - left > max_width) {
+            truncated = true;
+            break;
+        }
+
+        if (quads && count < num_quads) {
+            quads[count] = { x + qx, y + glyph->bearing_y, glyph->width, glyph->height, glyph->u0,
+                glyph->v0, glyph->u1, glyph->v1 };
+        }
+        count++;
+        cursor += glyph->advance;
+
+        // Don't put the ellipsis after whitespace
+        if (!is_whitespace(glyph->codepoint) && cursor + ellipsis_right - left <= max_width) {
+            cut = count;
+            cut_cursor = cursor;
+        }
+    }
+
+    if (truncated) {
+        count = cut;
+        es = { ellipsis, x + cut_cursor, 0 };
+        count += draw_text(fnt, &es, y, SIZE_MAX,
+            [&](size_t idx, const utxt_glyph& glyph, float qx, float qy) {
+                if (quads && count + idx < num_quads) {
+                    quads[count + idx] = { qx, qy, glyph.width, glyph.height, glyph.u0, glyph.v0,
+                        glyph.u1, glyph.v1 };
+                }
+                return true;
+            });
+    }
+
+    if (quads && count > num_quads) {
+        return num_quads + 1;
+    }
+    return count;
+}
+
+EXPORT size_t utxt_draw_text_append(
+    utxt_quad_buffer* buffer, const utxt_font* font, utxt_string text, float x, float y)
+{
+    auto& fnt = *(Font*)font;
+
+    if (!buffer->alloc.realloc) {
+        buffer->alloc = { realloc, nullptr };
+    }
+
+    // Every glyph takes at least one byte, so we can reserve enough space up front and don't have
+    // to count the quads first.
+    const auto required = buffer->num_quads + text.len;
+    if (required > buffer->capacity) {
+        const auto new_capacity = std::max(required, buffer->capacity * 2);
+        buffer->quads
+            = reallocate<utxt_quad>(buffer->alloc, buffer->quads, buffer->capacity, new_capacity);
+        buffer->capacity = new_capacity;
+    }
+
+    const auto quads = buffer->quads + buffer->num_quads;
+    utxt_draw_text_state s { text, x, 0 };
+    const auto n = draw_text(
+        fnt, &s, y, text.len, [quads](size_t idx, const utxt_glyph& glyph, float qx, float qy) {
+            quads[idx]
+                = { qx, qy, glyph.width, glyph.height, glyph.u0, glyph.v0, glyph.u1, glyph.v1 };
+            return true;
+        });
+    buffer->num_quads += n;
+    return n;
+}
+
+EXPORT void utxt_quad_buffer_free(utxt_quad_buffer* buffer)
+{
+    if (buffer->quads) {
+        reallocate<utxt_quad>(buffer->alloc, buffer->quads, buffer->capacity, 0);
+    }
+    buffer->quads = nullptr;
+    buffer->num_quads = 0;
+    buffer->capacity = 0;
+}
+
+// Returns false if the quad is fully outside of the clip rect.
+static bool clip_quad(utxt_quad& q, const utxt_rect& clip, utxt_clip_mode mode)
+{
+    const auto x0 = std::fmax(q.x, clip.x);
+    const auto y0 = std::fmax(q.y, clip.y);
+    const auto x1 = std::fmin(q.x + q.w, clip.x + clip.w);
+    const auto y1 = std::fmin(q.y + q.h, clip.y + clip.h);
+    if (x0 >= x1 || y0 >= y1) {
+        return false;
+    }
+    if (mode == UTXT_CLIP_CROP && (x0 != q.x || y0 != q.y || x1 != q.x + q.w || y1 != q.y + q.h)) {
+        const auto du = (q.u1 - q.u0) / q.w;
+        const auto dv = (q.v1 - q.v0) / q.h;
+        q = {
+            .x = x0,
+            .y = y0,
+            .w = x1 - x0,
+            .h = y1 - y0,
+            .u0 = q.u0 + (x0 - q.x) * du,
+            .v0 = q.v0 + (y0 - q.y) * dv,
+            .u1 = q.u0 + (x1 - q.x) * du,
+            .v1 = q.v0 + (y1 - q.y) * dv,
+        };
+    }
+    return true;
+}
+
+EXPORT size_t utxt_draw_text_clipped(utxt_quad* quads, size_t num_quads, const utxt_font* font,
+    utxt_string text, float x, float y, utxt_rect clip, utxt_clip_mode mode)
+{
+    auto& fnt = *(Font*)font;
+
+    // Glyphs can extend beyond ascent and descent (e.g. accents on capitals), so every glyph is
+    // culled on its own instead of the whole line.
+    // We don't know how many glyphs will be culled, so we keep counting when the buffer is full.
+    utxt_draw_text_state s { text, x, 0 };
+    const auto n = draw_text(fnt, &s, y, SIZE_MAX,
+        [=](size_t idx, const utxt_glyph& glyph, float qx, float qy) {
+            utxt_quad q { qx, qy, glyph.width, glyph.height, glyph.u0, glyph.v0, glyph.u1,
+                glyph.v1 };
+            if (!clip_quad(q, clip, mode)) {
+                return false;
+            }
+            if (quads && idx < num_quads) {
+                quads[idx] = q;
+            }
+            return true;
+        });
+    if (quads && n > num_quads) {
+        return num_quads + 1;
+    }
+    return n;
+}
+
+EXPORT size_t utxt_get_glyph_table(
+    const utxt_font* font, utxt_glyph_table_entry* table, size_t num_entries)
+{
+    auto& fnt = *(Font*)font;
+    const auto num_glyphs = get_num_glyphs(fnt);
+    if (!table) {
+        return num_glyphs;
+    }
+    if (num_entries < num_glyphs) {
+        return num_entries + 1;
+    }
+    for (size_t i = 0; i < num_glyphs; ++i) {
+        const auto& g = fnt.glyphs()[i];
+        table[i] = { g.width, g.height, g.u0, g.v0, g.u1, g.v1 };
+    }
+    return num_glyphs;
+}
+
+EXPORT size_t utxt_draw_text_instances(utxt_glyph_instance* instances, size_t num_instances,
+    const utxt_font* font, utxt_string text, float x, float y)
+{
+    auto& fnt = *(Font*)font;
+
+    if (!instances) {
+        return count_quads(font, text);
+    }
+
+    utxt_draw_text_state s { text, x, 0 };
+    const auto n = draw_text(fnt, &s, y, num_instances,
+        [instances, &fnt](size_t idx, const utxt_glyph& glyph, float qx, float qy) {
+            instances[idx] = { qx, qy, (uint32_t)(&glyph - fnt.glyphs()) };
+            return true;
+        });
+    if (s.text.len) {
+        return num_instances + 1;
+    }
+    return n;
+}
+
+// Words up to this many bytes are cached by the word cache
+constexpr size_t word_cache_max_length = 16;
+
+// A word laid out by utxt_layout_add_text relative to its start, before it is moved into place.
+struct WordCacheEntry {
+    const Font* font; // nullptr if unused
+    uint8_t length;
+    uint8_t num_glyphs;
+    float advance; // word_cursor_x after the last glyph
+    char bytes[word_cache_max_length];
+    uint8_t text_offsets[word_cache_max_length]; // relative to the start of the word
+    const utxt_glyph* glyphs[word_cache_max_length];
+    float xs[word_cache_max_length];
+};
+
+// Direct-mapped, i.e. a word can only be in one entry and replaces whatever was there before.
+struct WordCache {
+    utxt_alloc alloc;
+    WordCacheEntry* entries;
+    size_t num_entries; // power of two
+};
+
+static uint64_t hash_word(const Font& font, const char* word, size_t length)
+{
+    const auto font_addr = (uintptr_t)&font;
+    return hash_bytes(hash_bytes(hash_seed, &font_addr, sizeof(font_addr)), word, length);
+}
+
+static WordCacheEntry& get_word_cache_entry(
+    WordCache& cache, const Font& font, const char* word, size_t length)
+{
+    return cache.entries[hash_word(font, word, length) & (cache.num_entries - 1)];
+}
+
+EXPORT utxt_word_cache* utxt_word_cache_create(utxt_alloc alloc, uint32_t num_entries)
+{
+    if (!alloc.realloc) {
+        alloc = { realloc, nullptr };
+    }
+    auto cache = allocate<WordCache>(alloc);
+    cache->alloc = alloc;
+    cache->num_entries = std::bit_ceil(std::max(num_entries, 1u));
+    cache->entries = allocate<WordCacheEntry>(alloc, cache->num_entries);
+    return (utxt_word_cache*)cache;
+}
+
+EXPORT void utxt_word_cache_free(utxt_word_cache* cache_)
+{
+    auto cache = (WordCache*)cache_;
+    deallocate(cache->alloc, cache->entries, cache->num_entries);
+    deallocate(cache->alloc, cache);
+}
+
+EXPORT void utxt_word_cache_clear(utxt_word_cache* cache_)
+{
+    auto& cache = *(WordCache*)cache_;
+    for (size_t i = 0; i < cache.num_entries; ++i) {
+        cache.entries[i].font = nullptr;
+    }
+}
+
+// The part of a line's state that is not in utxt_layout_line, but needed for utxt_layout_rewind.
+struct LineState {
+    float start_height; // current_line_height at the start of the line
+    float start_ascent;
+    bool wrapped; // whether the line started because the previous one was full (not '\n')
+};
+
 struct Layout {
     utxt_alloc alloc;
     utxt_layout_glyph* lglyphs = nullptr;
+    size_t* glyph_text_offsets = nullptr; // parallel to lglyphs, in the same allocation
     size_t num_lglyphs = 0;
     size_t lglyph_idx = 0;
     float wrap_width = 0.0f;
@@ -616,8 +1475,112 @@ struct Layout {
     float cursor_y = 0.0f;
     size_t line_start_idx = 0;
     float current_line_height = 0.0f;
+    utxt_layout_growth growth = UTXT_LAYOUT_GROWTH_NONE;
+    size_t num_dropped = 0; // glyphs that did not fit since the last reset
+    // The current line is always the last line. Its num_glyphs, x and width are only updated in
+    // utxt_layout_compute and utxt_layout_get_lines.
+    utxt_layout_line* lines = nullptr;
+    LineState* line_states = nullptr; // parallel to lines, in the same allocation
+    size_t num_lines = 0;
+    size_t lines_capacity = 0;
+    size_t text_offset = 0; // number of bytes added since the last reset
+    // x of the current line's glyphs before utxt_layout_compute aligned them, nullptr if it did not
+    float* unaligned_xs = nullptr;
+    size_t num_unaligned_xs = 0;
+    size_t first_changed = 0; // glyphs before this did not change since utxt_layout_take_changes
+    WordCache* word_cache = nullptr;
 };
 
+static void resize_glyphs(Layout& layout, size_t new_size)
+{
+    resize_parallel(layout.alloc, layout.lglyphs, layout.glyph_text_offsets, layout.num_lglyphs,
+        new_size);
+    layout.num_lglyphs = new_size;
+}
+
+// Makes sure there is space for count more glyphs, growing the buffer if allowed.
+static bool reserve_glyphs(Layout& layout, size_t count)
+{
+    const auto required = layout.lglyph_idx + count;
+    if (required <= layout.num_lglyphs) {
+        return true;
+    }
+    if (layout.growth == UTXT_LAYOUT_GROWTH_NONE) {
+        return false;
+    }
+    resize_glyphs(layout, std::max({ required, layout.num_lglyphs * 2, (size_t)64 }));
+    return true;
+}
+
+// Number of glyphs utxt_layout_add_text would add for text (i.e. without whitespace).
+static size_t count_layout_glyphs(Font& font, utxt_string text)
+{
+    size_t count = 0;
+    while (text.len) {
+        const auto cp = decode_utf8(text);
+        if (cp != 0 && !is_whitespace(cp) && find_glyph(font, cp)) {
+            count++;
+        }
+    }
+    return count;
+}
+
+// Once glyphs were dropped, all text after them is dropped as well, even if it would fit into the
+// space left by a dropped word, so the glyphs that are kept are the same as with enough capacity.
+static void drop_text(Layout& layout, Font& font, utxt_string text)
+{
+    layout.text_offset += text.len;
+    layout.num_dropped += count_layout_glyphs(font, text);
+}
+
+static void reserve_lines(Layout& layout, size_t count)
+{
+    const auto required = layout.num_lines + count;
+    if (required > layout.lines_capacity) {
+        const auto new_capacity = std::max({ required, layout.lines_capacity * 2, (size_t)16 });
+        resize_parallel(layout.alloc, layout.lines, layout.line_states, layout.lines_capacity,
+            new_capacity);
+        layout.lines_capacity = new_capacity;
+    }
+}
+
+static void begin_line(Layout& layout, size_t text_offset, float ascent, bool wrapped)
+{
+    reserve_lines(layout, 1);
+    layout.lines[layout.num_lines] = {
+        .first_glyph = layout.lglyph_idx,
+        .num_glyphs = 0,
+        .text_offset = text_offset,
+        .x = 0.0f,
+        .y = layout.cursor_y,
+        .width = 0.0f,
+        .height = layout.current_line_height,
+        .ascent = ascent,
+    };
+    layout.line_states[layout.num_lines] = { layout.current_line_height, ascent, wrapped };
+    layout.num_lines++;
+}
+
+static void discard_unaligned_xs(Layout& layout)
+{
+    deallocate(layout.alloc, layout.unaligned_xs, layout.num_unaligned_xs);
+    layout.unaligned_xs = nullptr;
+    layout.num_unaligned_xs = 0;
+}
+
+static utxt_layout_line& current_line(Layout& layout)
+{
+    return layout.lines[layout.num_lines - 1];
+}
+
+// Makes room for a font in the current line
+static void add_font_to_line(Layout& layout, Font& font)
+{
+    layout.current_line_height = std::fmax(layout.current_line_height, font.metrics.line_height);
+    auto& line = current_line(layout);
+    line.ascent = std::fmax(line.ascent, font.metrics.ascent);
+}
+
 EXPORT utxt_layout* utxt_layout_create(utxt_alloc alloc, uint32_t num_glyphs)
 {
     if (!alloc.realloc) {
@@ -625,23 +1588,57 @@ EXPORT utxt_layout* utxt_layout_create(utxt_alloc alloc, uint32_t num_glyphs)
     }
     auto layout = allocate<Layout>(alloc);
     layout->alloc = alloc;
-    layout->num_lglyphs = num_glyphs;
-    if (layout->num_lglyphs) {
-        layout->lglyphs = allocate<utxt_layout_glyph>(alloc, num_glyphs);
+    if (num_glyphs) {
+        resize_glyphs(*layout, num_glyphs);
     }
+    begin_line(*layout, 0, 0.0f, false);
     return (utxt_layout*)layout;
 }
 
 EXPORT void utxt_layout_free(utxt_layout* layout_)
 {
     auto layout = (Layout*)layout_;
-    deallocate(layout->alloc, layout->lglyphs, layout->num_lglyphs);
+    discard_unaligned_xs(*layout);
+    resize_parallel(layout->alloc, layout->lines, layout->line_states, layout->lines_capacity, 0);
+    resize_parallel(
+        layout->alloc, layout->lglyphs, layout->glyph_text_offsets, layout->num_lglyphs, 0);
     deallocate(layout->alloc, layout);
 }
 
+EXPORT void utxt_layout_set_growth(utxt_layout* layout_, utxt_layout_growth growth)
+{
+    auto& layout = *(Layout*)layout_;
+    layout.growth = growth;
+}
+
+EXPORT void utxt_layout_set_word_cache(utxt_layout* layout_, utxt_word_cache* cache)
+{
+    auto& layout = *(Layout*)layout_;
+    layout.word_cache = (WordCache*)cache;
+}
+
+EXPORT size_t utxt_layout_get_capacity(const utxt_layout* layout_)
+{
+    auto& layout = *(const Layout*)layout_;
+    return layout.num_lglyphs;
+}
+
+EXPORT size_t utxt_layout_get_required_capacity(const utxt_layout* layout_)
+{
+    auto& layout = *(const Layout*)layout_;
+    return layout.lglyph_idx + layout.num_dropped;
+}
+
 EXPORT void utxt_layout_reset(utxt_layout* layout_, float wrap_width, utxt_text_align align)
 {
     auto& layout = *(Layout*)layout_;
+    if (layout.growth == UTXT_LAYOUT_GROWTH_SHRINK) {
+        // Shrink to what the previous layout needed, which is likely what the next one needs.
+        const auto required = layout.lglyph_idx + layout.num_dropped;
+        if (required < layout.num_lglyphs) {
+            resize_glyphs(layout, required);
+        }
+    }
     layout.wrap_width = wrap_width;
     layout.align = align;
     layout.lglyph_idx = 0;
@@ -649,11 +1646,12 @@ EXPORT void utxt_layout_reset(utxt_layout* layout_, float wrap_width, utxt_text_
     layout.cursor_y = 0;
     layout.line_start_idx = 0;
     layout.current_line_height = 0.0f;
-}
-
-static bool is_whitespace(uint32_t cp)
-{
-    return cp == ' ' || cp == '\n' || cp == '\r';
+    layout.num_dropped = 0;
+    layout.num_lines = 0;
+    layout.text_offset = 0;
+    discard_unaligned_xs(layout);
+    layout.first_changed = 0;
+    begin_line(layout, 0, 0.0f, false);
 }
 
 // This returns the visual width of a span of layout glyphs, i.e. from the left edge of the first
@@ -676,54 +1674,91 @@ static void shift_glyphs(std::span<utxt_layout_glyph> lglyphs, float shift)
     }
 }
 
+// Aligns the current line.
 static void align_line(Layout& layout)
 {
     const auto line = std::span { layout.lglyphs, layout.num_lglyphs }.subspan(
         layout.line_start_idx, layout.lglyph_idx - layout.line_start_idx);
-    if (layout.align == UTXT_TEXT_ALIGN_CENTER) {
-        shift_glyphs(line, layout.wrap_width / 2.0f - get_width(line) / 2.0f);
-    } else if (layout.align == UTXT_TEXT_ALIGN_RIGHT) {
-        shift_glyphs(line, layout.wrap_width - get_width(line));
+    if (layout.align == UTXT_TEXT_ALIGN_LEFT || line.empty()) {
+        return;
+    }
+    const auto shift = layout.align == UTXT_TEXT_ALIGN_CENTER
+        ? layout.wrap_width / 2.0f - get_width(line) / 2.0f
+        : layout.wrap_width - get_width(line);
+    shift_glyphs(line, shift);
+    layout.first_changed = std::min(layout.first_changed, layout.line_start_idx);
+}
+
+// Updates the fields of the current line that depend on its glyphs.
+static void update_current_line(Layout& layout)
+{
+    auto& line = current_line(layout);
+    line.num_glyphs = layout.lglyph_idx - line.first_glyph;
+    line.height = layout.current_line_height;
+    if (line.num_glyphs) {
+        const auto glyphs = std::span { layout.lglyphs + line.first_glyph, line.num_glyphs };
+        line.x = glyphs[0].x - glyphs[0].glyph->bearing_x;
+        line.width = get_width(glyphs);
+    } else {
+        line.x = 0.0f;
+        line.width = 0.0f;
+    }
+}
+
+// utxt_layout_compute aligns the current line, which has to be undone if we add more to it.
+// Shifting the glyphs back does not always give the same floats, so their old positions are
+// restored instead.
+static void unalign_current_line(Layout& layout)
+{
+    if (layout.unaligned_xs) {
+        for (size_t i = 0; i < layout.num_unaligned_xs; ++i) {
+            layout.lglyphs[layout.line_start_idx + i].x = layout.unaligned_xs[i];
+        }
+        layout.first_changed = std::min(layout.first_changed, layout.line_start_idx);
+        discard_unaligned_xs(layout);
     }
 }
 
-static void break_current_line(Layout& layout, Font& font)
+// text_offset is where the next line starts in the text (relative to the last reset).
+static void break_current_line(Layout& layout, Font& font, size_t text_offset, bool wrapped)
 {
     layout.cursor_x = 0.0f;
     layout.cursor_y += layout.current_line_height;
     align_line(layout);
+    update_current_line(layout);
     layout.line_start_idx = layout.lglyph_idx;
     layout.current_line_height = font.metrics.line_height;
+    begin_line(layout, text_offset, font.metrics.ascent, wrapped);
 }
 
-static bool flush_chunk(
-    Layout& layout, Font& font, std::span<const utxt_layout_glyph> lglyphs, float chunk_advance)
+// The glyphs of the current word are written to lglyphs[word_start, lglyph_idx) relative to the
+// start of the word. Once the word is complete, we know whether it fits in the current line and
+// move it into place.
+static void end_word(
+    Layout& layout, Font& font, size_t word_start, size_t word_text_offset, float word_advance)
 {
-    if (lglyphs.size() == 0) {
-        return true;
+    if (word_start == layout.lglyph_idx) {
+        return;
     }
 
-    if (layout.lglyph_idx + lglyphs.size() > layout.num_lglyphs) {
-        return false;
-    }
-    const auto chunk_width = get_width(lglyphs);
+    const auto word = std::span { layout.lglyphs + word_start, layout.lglyph_idx - word_start };
+    const auto word_width = get_width(word);
 
-    if (layout.cursor_x > 0.0f && layout.cursor_x + chunk_width > layout.wrap_width) {
-        // chunk does not fit in current line, so break first
-        break_current_line(layout, font);
+    if (layout.cursor_x > 0.0f && layout.cursor_x + word_width > layout.wrap_width) {
+        // word does not fit in current line, so break before it
+        layout.lglyph_idx = word_start;
+        break_current_line(layout, font, word_text_offset, true);
+        layout.lglyph_idx = word_start + word.size();
     }
 
-    for (size_t i = 0; i < lglyphs.size(); ++i) {
-        auto& g = layout.lglyphs[layout.lglyph_idx++] = lglyphs[i];
+    for (auto& g : word) {
         g.x += layout.cursor_x;
         g.y += layout.cursor_y;
     }
 
-    // We advance by chunk_advance here, as that is the sum of advances that should actually
-    // separate glyphs. If we were to use chunk_width then we would be off by (advance - width).
-    layout.cursor_x += chunk_advance;
-
-    return true;
+    // We advance by word_advance here, as that is the sum of advances that should actually
+    // separate glyphs. If we were to use word_width then we would be off by (advance - width).
+    layout.cursor_x += word_advance;
 }
 
 EXPORT size_t utxt_layout_add_text(utxt_layout* layout_, const utxt_font* font_, utxt_string text)
@@ -734,15 +1769,87 @@ EXPORT size_t utxt_layout_add_text(utxt_layout* layout_, const utxt_font* font_,
     const auto space_glyph = find_glyph(font, ' ');
     assert(space_glyph);
     const auto space_advance = space_glyph->advance;
-    layout.current_line_height = std::fmax(layout.current_line_height, font.metrics.line_height);
+    if (layout.num_dropped) {
+        drop_text(layout, font, text);
+        return 0;
+    }
+    unalign_current_line(layout);
+    add_font_to_line(layout, font);
 
     const auto lglyph_idx_before = layout.lglyph_idx;
+    const auto text_begin = text.data;
+    const auto text_offset = layout.text_offset;
+    layout.text_offset += text.len;
     uint32_t prev_glyph_idx = 0; // for kerning
-    std::array<utxt_layout_glyph, 128> chunk;
-    size_t chunk_idx = 0;
-    float chunk_cursor_x = 0.0f;
+    // Glyphs are written directly into the layout, so words can be arbitrarily long
+    size_t word_start = layout.lglyph_idx;
+    size_t word_text_offset = text_offset;
+    float word_cursor_x = 0.0f;
+    // Word cache: At the start of every word we look it up. If it is not in the cache, we store it
+    // once we reach its end (before end_word moves it into place).
+    bool at_word_start = true;
+    WordCacheEntry* store_entry = nullptr;
+    const char* store_word = nullptr;
+    size_t store_length = 0;
+
+    auto store_cached_word = [&]() {
+        if (!store_entry) {
+            return;
+        }
+        const auto num_glyphs = layout.lglyph_idx - word_start;
+        if (num_glyphs > 0) {
+            auto& e = *store_entry;
+            e.font = &font;
+            e.length = (uint8_t)store_length;
+            e.num_glyphs = (uint8_t)num_glyphs;
+            e.advance = word_cursor_x;
+            std::memcpy(e.bytes, store_word, store_length);
+            const auto word_offset = text_offset + (size_t)(store_word - text_begin);
+            for (size_t i = 0; i < num_glyphs; ++i) {
+                const auto& lg = layout.lglyphs[word_start + i];
+                e.glyphs[i] = lg.glyph;
+                e.xs[i] = lg.x;
+                e.text_offsets[i]
+                    = (uint8_t)(layout.glyph_text_offsets[word_start + i] - word_offset);
+            }
+        }
+        store_entry = nullptr;
+    };
 
     while (text.len) {
+        const auto cp_offset = text_offset + (size_t)(text.data - text_begin);
+
+        if (at_word_start && layout.word_cache) {
+            at_word_start = false;
+            size_t length = 0;
+            while (length < text.len && length <= word_cache_max_length
+                && !is_whitespace((uint8_t)text.data[length])) {
+                length++;
+            }
+            if (length > 0 && length <= word_cache_max_length) {
+                auto& entry = get_word_cache_entry(*layout.word_cache, font, text.data, length);
+                const auto hit = entry.font == &font && entry.length == length
+                    && std::memcmp(entry.bytes, text.data, length) == 0;
+                if (hit && reserve_glyphs(layout, entry.num_glyphs)) {
+                    for (size_t i = 0; i < entry.num_glyphs; ++i) {
+                        const auto glyph = entry.glyphs[i];
+                        const auto idx = layout.lglyph_idx++;
+                        layout.glyph_text_offsets[idx] = cp_offset + entry.text_offsets[i];
+                        layout.lglyphs[idx] = { glyph, entry.xs[i], glyph->bearing_y };
+                    }
+                    word_text_offset = cp_offset + entry.text_offsets[0];
+                    word_cursor_x = entry.advance;
+                    prev_glyph_idx = entry.glyphs[entry.num_glyphs - 1]->glyph_index;
+                    text = { text.data + length, text.len - length };
+                    continue;
+                } else if (!hit) {
+                    store_entry = &entry;
+                    store_word = text.data;
+                    store_length = length;
+                }
+            }
+        }
+
         const auto cp = decode_utf8(text);
         if (cp == 0) {
             // skip and reset kerning
@@ -751,14 +1858,14 @@ EXPORT size_t utxt_layout_add_text(utxt_layout* layout_, const utxt_font* font_,
         }
 
         if (is_whitespace(cp)) {
-            if (!flush_chunk(layout, font, std::span { chunk }.first(chunk_idx), chunk_cursor_x)) {
-                break;
-            }
-            chunk_idx = 0;
-            chunk_cursor_x = 0.0f;
+            store_cached_word();
+            end_word(layout, font, word_start, word_text_offset, word_cursor_x);
+            word_start = layout.lglyph_idx;
+            word_cursor_x = 0.0f;
+            at_word_start = true;
 
             if (cp == '\n') {
-                break_current_line(layout, font);
+                break_current_line(layout, font, cp_offset + 1, false);
             } else if (cp == ' ') {
                 // Only advance cursor for space if it's not at the beginning of a line
                 if (layout.cursor_x > 0.0f) {
@@ -776,27 +1883,421 @@ EXPORT size_t utxt_layout_add_text(utxt_layout* layout_, const utxt_font* font_,
             continue;
         }
 
-        assert(chunk_idx < chunk.size());
+        if (!reserve_glyphs(layout, 1)) {
+            // Drop the whole word, like the rest of the text
+            const auto word_glyphs = layout.lglyph_idx - word_start + 1;
+            layout.num_dropped += word_glyphs + count_layout_glyphs(font, text);
+            layout.lglyph_idx = word_start;
+            return layout.lglyph_idx - lglyph_idx_before;
+        }
+
+        if (word_start == layout.lglyph_idx) {
+            word_text_offset = cp_offset;
+        }
 
         if (prev_glyph_idx) {
-            chunk_cursor_x += utxt_get_kerning(font_, prev_glyph_idx, glyph->glyph_index);
+            word_cursor_x += utxt_get_kerning(font_, prev_glyph_idx, glyph->glyph_index);
         }
         prev_glyph_idx = glyph->glyph_index;
 
-        chunk[chunk_idx++] = { glyph, chunk_cursor_x + glyph->bearing_x, glyph->bearing_y };
+        layout.glyph_text_offsets[layout.lglyph_idx] = cp_offset;
+        layout.lglyphs[layout.lglyph_idx++]
+            = { glyph, word_cursor_x + glyph->bearing_x, glyph->bearing_y };
+
+        word_cursor_x += glyph->advance;
+    }
+
+    store_cached_word();
+    end_word(layout, font, word_start, word_text_offset, word_cursor_x);
 
-        chunk_cursor_x += glyph->advance;
+    return layout.lglyph_idx - lglyph_idx_before;
+}
+
+EXPORT size_t utxt_layout_add_glyphs(
+    utxt_layout* layout_, const utxt_font* font_, utxt_string text)
+{
+    auto& layout = *(Layout*)layout_;
+    auto& font = *(Font*)font_;
+
+    const auto space_glyph = find_glyph(font, ' ');
+    assert(space_glyph);
+    const auto space_advance = space_glyph->advance;
+    if (layout.num_dropped) {
+        drop_text(layout, font, text);
+        return 0;
     }
+    unalign_current_line(layout);
+    add_font_to_line(layout, font);
+
+    const auto lglyph_idx_before = layout.lglyph_idx;
+    const auto text_begin = text.data;
+    const auto text_offset = layout.text_offset;
+    layout.text_offset += text.len;
+    uint32_t prev_glyph_idx = 0; // for kerning
+
+    while (text.len) {
+        const auto cp_offset = text_offset + (size_t)(text.data - text_begin);
+        const auto cp = decode_utf8(text);
+        if (cp == 0) {
+            // skip and reset kerning
+            prev_glyph_idx = 0;
+            continue;
+        }
+
+        if (is_whitespace(cp)) {
+            if (cp == '\n') {
+                break_current_line(layout, font, cp_offset + 1, false);
+            } else if (cp == ' ') {
+                // Only advance cursor for space if it's not at the beginning of a line
+                if (layout.cursor_x > 0.0f) {
+                    layout.cursor_x += space_advance;
+                }
+            }
+            prev_glyph_idx = 0;
+            continue;
+        }
+
+        const auto glyph = find_glyph(font, cp);
+        if (!glyph) {
+            // skip and reset kerning
+            prev_glyph_idx = 0;
+            continue;
+        }
+
+        if (!reserve_glyphs(layout, 1)) {
+            layout.num_dropped += 1 + count_layout_glyphs(font, text);
+            break;
+        }
+
+        // Every glyph is its own word, so this is the same wrapping logic as in end_word.
+        auto cursor_x = layout.cursor_x;
+        if (prev_glyph_idx) {
+            cursor_x += utxt_get_kerning(font_, prev_glyph_idx, glyph->glyph_index);
+        }
+        prev_glyph_idx = glyph->glyph_index;
+
+        if (cursor_x > 0.0f && cursor_x + glyph->bearing_x + glyph->width > layout.wrap_width) {
+            break_current_line(layout, font, cp_offset, true);
+            cursor_x = 0.0f;
+        }
 
-    flush_chunk(layout, font, std::span { chunk }.first(chunk_idx), chunk_cursor_x);
+        layout.glyph_text_offsets[layout.lglyph_idx] = cp_offset;
+        layout.lglyphs[layout.lglyph_idx++]
+            = { glyph, cursor_x + glyph->bearing_x, layout.cursor_y + glyph->bearing_y };
+        layout.cursor_x = cursor_x + glyph->advance;
+    }
 
     return layout.lglyph_idx - lglyph_idx_before;
 }
 
+// Text smaller than this is not split up further for utxt_layout_add_text_parallel.
+constexpr size_t parallel_min_segment_size = 16 * 1024;
+
+EXPORT size_t utxt_layout_add_text_parallel(utxt_layout* layout_, const utxt_font* font,
+    utxt_string text, utxt_layout_parallel_params params)
+{
+    auto& layout = *(Layout*)layout_;
+    if (!params.alloc.realloc) {
+        params.alloc = { realloc, nullptr };
+    }
+    if (!params.num_threads) {
+        params.num_threads = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+
+    // If glyphs might be dropped, it matters which ones, so we just do it sequentially.
+    const auto newline = (const char*)std::memchr(text.data, '\n', text.len);
+    if (layout.growth == UTXT_LAYOUT_GROWTH_NONE || !newline || params.num_threads == 1) {
+        return utxt_layout_add_text(layout_, font, text);
+    }
+
+    // The rest of the current paragraph continues the current line, so it is done sequentially.
+    // Everything after it starts on a new line and can be split at any '\n'.
+    const auto head_len = (size_t)(newline - text.data) + 1;
+    auto num_added = utxt_layout_add_text(layout_, font, { text.data, head_len });
+    text = { text.data + head_len, text.len - head_len };
+
+    const auto max_segments = std::min<size_t>(
+        params.num_threads * 4, std::max<size_t>(text.len / parallel_min_segment_size, 1));
+    if (max_segments <= 1) {
+        return num_added + utxt_layout_add_text(layout_, font, text);
+    }
+
+    auto segment_ends = allocate<size_t>(params.alloc, max_segments);
+    size_t num_segments = 0;
+    for (size_t start = 0; start < text.len;) {
+        auto end = text.len;
+        if (num_segments + 1 < max_segments) {
+            end = std::min(start + text.len / max_segments, text.len);
+            const auto nl = (const char*)std::memchr(text.data + end, '\n', text.len - end);
+            end = nl ? (size_t)(nl - text.data) + 1 : text.len;
+        }
+        segment_ends[num_segments++] = end;
+        start = end;
+    }
+
+    // Every segment is laid out into its own layout, as if it was the start of the text
+    auto segments = allocate<utxt_layout*>(params.alloc, num_segments);
+    parallel_for(params.alloc, params.num_threads, num_segments, [&](size_t i) {
+        const auto start = i > 0 ? segment_ends[i - 1] : 0;
+        segments[i] = utxt_layout_create(params.alloc, 0);
+        utxt_layout_set_growth(segments[i], UTXT_LAYOUT_GROWTH_GROW);
+        utxt_layout_reset(segments[i], layout.wrap_width, layout.align);
+        utxt_layout_add_text(segments[i], font, { text.data + start, segment_ends[i] - start });
+    });
+
+    // Append the lines of every segment in order. The first line of a segment replaces the empty
+    // line that was started by the '\n' before it. y is accumulated line by line exactly like
+    // break_current_line does, so the result is identical to utxt_layout_add_text.
+    auto glyph_bases = allocate<size_t>(params.alloc, num_segments);
+    auto line_bases = allocate<size_t>(params.alloc, num_segments);
+    auto text_bases = allocate<size_t>(params.alloc, num_segments);
+    for (size_t i = 0; i < num_segments; ++i) {
+        const auto& segment = *(Layout*)segments[i];
+        num_added += segment.lglyph_idx;
+        reserve_glyphs(layout, segment.lglyph_idx);
+        reserve_lines(layout, segment.num_lines);
+
+        const auto first_state = layout.line_states[layout.num_lines - 1];
+        layout.num_lines--;
+        glyph_bases[i] = layout.lglyph_idx;
+        line_bases[i] = layout.num_lines;
+        text_bases[i] = layout.text_offset;
+        for (size_t l = 0; l < segment.num_lines; ++l) {
+            if (l > 0) {
+                layout.cursor_y += segment.lines[l - 1].height;
+            }
+            auto line = segment.lines[l];
+            line.first_glyph += glyph_bases[i];
+            line.text_offset += layout.text_offset;
+            line.y = layout.cursor_y;
+            layout.lines[layout.num_lines] = line;
+            layout.line_states[layout.num_lines] = l > 0 ? segment.line_states[l] : first_state;
+            layout.num_lines++;
+        }
+
+        layout.lglyph_idx += segment.lglyph_idx;
+        layout.text_offset += segment.text_offset;
+        layout.cursor_x = segment.cursor_x;
+        layout.line_start_idx = glyph_bases[i] + segment.line_start_idx;
+        layout.current_line_height = segment.current_line_height;
+    }
+
+    parallel_for(params.alloc, params.num_threads, num_segments, [&](size_t i) {
+        const auto& segment = *(Layout*)segments[i];
+        for (size_t l = 0; l < segment.num_lines; ++l) {
+            const auto first = segment.lines[l].first_glyph;
+            const auto end = l + 1 < segment.num_lines ? segment.lines[l + 1].first_glyph
+                                                       : segment.lglyph_idx;
+            const auto y = layout.lines[line_bases[i] + l].y;
+            for (auto g = first; g < end; ++g) {
+                const auto& lg = segment.lglyphs[g];
+                layout.lglyphs[glyph_bases[i] + g] = { lg.glyph, lg.x, lg.glyph->bearing_y + y };
+                layout.glyph_text_offsets[glyph_bases[i] + g]
+                    = text_bases[i] + segment.glyph_text_offsets[g];
+            }
+        }
+    });
+
+    for (size_t i = 0; i < num_segments; ++i) {
+        utxt_layout_free(segments[i]);
+    }
+    deallocate(params.alloc, text_bases, num_segments);
+    deallocate(params.alloc, line_bases, num_segments);
+    deallocate(params.alloc, glyph_bases, num_segments);
+    deallocate(params.alloc, segments, num_segments);
+    deallocate(params.alloc, segment_ends, max_segments);
+    return num_added;
+}
+
+// This mirrors utxt_layout_add_text (and end_word and break_current_line), but only keeps the
+// numbers needed to know where lines break. The float operations are done in the same order, so
+// the results are identical.
+EXPORT utxt_text_size utxt_measure_text(const utxt_font* font_, utxt_string text, float wrap_width)
+{
+    auto& font = *(Font*)font_;
+
+    const auto space_glyph = find_glyph(font, ' ');
+    assert(space_glyph);
+    const auto space_advance = space_glyph->advance;
+    const auto line_height = font.metrics.line_height;
+
+    utxt_text_size size { 0.0f, 0.0f, 1 };
+    float cursor_x = 0.0f;
+    float cursor_y = 0.0f;
+    float line_width = 0.0f;
+    uint32_t prev_glyph_idx = 0; // for kerning
+    bool in_word = false;
+    float word_cursor_x = 0.0f;
+    // Relative x and width of the last glyph in the current word
+    float word_last_x = 0.0f;
+    float word_last_width = 0.0f;
+
+    auto break_line = [&] {
+        size.width = std::fmax(size.width, line_width);
+        size.num_lines++;
+        cursor_x = 0.0f;
+        cursor_y += line_height;
+        line_width = 0.0f;
+    };
+
+    auto end_word = [&] {
+        if (!in_word) {
+            return;
+        }
+        // Lines always start at 0, so the width of a word or a line is where its last glyph ends.
+        if (cursor_x > 0.0f && cursor_x + (word_last_x + word_last_width) > wrap_width) {
+            break_line();
+        }
+        line_width = word_last_x + cursor_x + word_last_width;
+        cursor_x += word_cursor_x;
+        in_word = false;
+    };
+
+    while (text.len) {
+        const auto cp = decode_utf8(text);
+        if (cp == 0) {
+            prev_glyph_idx = 0;
+            continue;
+        }
+
+        if (is_whitespace(cp)) {
+            end_word();
+            if (cp == '\n') {
+                break_line();
+            } else if (cp == ' ' && cursor_x > 0.0f) {
+                cursor_x += space_advance;
+            }
+            prev_glyph_idx = 0;
+            continue;
+        }
+
+        const auto glyph = find_glyph(font, cp);
+        if (!glyph) {
+            prev_glyph_idx = 0;
+            continue;
+        }
+
+        if (!in_word) {
+            in_word = true;
+            word_cursor_x = 0.0f;
+        }
+        if (prev_glyph_idx) {
+            word_cursor_x += utxt_get_kerning(font_, prev_glyph_idx, glyph->glyph_index);
+        }
+        prev_glyph_idx = glyph->glyph_index;
+        word_last_x = word_cursor_x + glyph->bearing_x;
+        word_last_width = glyph->width;
+        word_cursor_x += glyph->advance;
+    }
+    end_word();
+
+    size.width = std::fmax(size.width, line_width);
+    size.height = cursor_y + line_height;
+    return size;
+}
+
+// Scaling all metrics by scale and wrapping at box_width is the same as wrapping the unscaled text
+// at box_width / scale and scaling the result.
+static bool fits_box(const utxt_font* font, utxt_string text, float box_width, float box_height,
+    float scale)
+{
+    const auto size = utxt_measure_text(font, text, box_width / scale);
+    return size.width * scale <= box_width && size.height * scale <= box_height;
+}
+
+EXPORT float utxt_fit_text(const utxt_font* font, utxt_string text, float box_width,
+    float box_height, float min_scale, float max_scale)
+{
+    assert(min_scale > 0.0f && min_scale <= max_scale);
+    if (fits_box(font, text, box_width, box_height, max_scale)) {
+        return max_scale;
+    }
+    if (!fits_box(font, text, box_width, box_height, min_scale)) {
+        return min_scale;
+    }
+
+    // Sizes are perceived relatively, so we stop once the bounds are within 0.1% of each other.
+    auto low = min_scale; // fits
+    auto high = max_scale; // does not fit
+    for (int i = 0; i < 64 && high > low * 1.001f; ++i) {
+        const auto mid = low + (high - low) / 2.0f;
+        if (fits_box(font, text, box_width, box_height, mid)) {
+            low = mid;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
 EXPORT void utxt_layout_compute(utxt_layout* layout_)
 {
     auto& layout = *(Layout*)layout_;
+    unalign_current_line(layout);
+    const auto num_glyphs = layout.lglyph_idx - layout.line_start_idx;
+    if (layout.align != UTXT_TEXT_ALIGN_LEFT && num_glyphs) {
+        layout.unaligned_xs = allocate<float>(layout.alloc, num_glyphs);
+        layout.num_unaligned_xs = num_glyphs;
+        for (size_t i = 0; i < num_glyphs; ++i) {
+            layout.unaligned_xs[i] = layout.lglyphs[layout.line_start_idx + i].x;
+        }
+    }
     align_line(layout);
+    update_current_line(layout);
+}
+
+EXPORT size_t utxt_layout_rewind(utxt_layout* layout_, size_t text_offset)
+{
+    auto& layout = *(Layout*)layout_;
+
+    // Find the last line that starts at or before text_offset
+    size_t low = 0;
+    size_t high = layout.num_lines;
+    while (high - low > 1) {
+        const auto mid = low + (high - low) / 2;
+        if (layout.lines[mid].text_offset <= text_offset) {
+            low = mid;
+        } else {
+            high = mid;
+        }
+    }
+    auto line_idx = low;
+    // If the line was wrapped, a change in its first word might make it fit on the previous line.
+    if (line_idx > 0 && layout.line_states[line_idx].wrapped) {
+        line_idx--;
+    }
+
+    // Restore the state from the beginning of the line and keep the line as the current line
+    auto& line = layout.lines[line_idx];
+    const auto& state = layout.line_states[line_idx];
+    line.ascent = state.start_ascent;
+    layout.num_lines = line_idx + 1;
+    layout.lglyph_idx = line.first_glyph;
+    layout.line_start_idx = line.first_glyph;
+    layout.cursor_x = 0.0f;
+    layout.cursor_y = line.y;
+    layout.current_line_height = state.start_height;
+    layout.text_offset = line.text_offset;
+    discard_unaligned_xs(layout);
+    layout.num_dropped = 0;
+    layout.first_changed = std::min(layout.first_changed, line.first_glyph);
+    return line.text_offset;
+}
+
+EXPORT const utxt_layout_line* utxt_layout_get_lines(utxt_layout* layout_, size_t* count)
+{
+    auto& layout = *(Layout*)layout_;
+    update_current_line(layout);
+    *count = layout.num_lines;
+    return layout.lines;
+}
+
+EXPORT utxt_layout_range utxt_layout_take_changes(utxt_layout* layout_)
+{
+    auto& layout = *(Layout*)layout_;
+    const auto first = std::min(layout.first_changed, layout.lglyph_idx);
+    layout.first_changed = layout.lglyph_idx;
+    return { first, layout.lglyph_idx - first };
 }
 
 EXPORT utxt_layout_glyph* utxt_layout_get_glyphs(utxt_layout* layout_, size_t* count)
@@ -806,6 +2307,74 @@ EXPORT utxt_layout_glyph* utxt_layout_get_glyphs(utxt_layout* layout_, size_t* c
     return layout.lglyphs;
 }
 
+EXPORT const size_t* utxt_layout_get_glyph_text_offsets(utxt_layout* layout_, size_t* count)
+{
+    auto& layout = *(Layout*)layout_;
+    *count = layout.lglyph_idx;
+    return layout.glyph_text_offsets;
+}
+
+// The cursor position before the glyph was added
+static float get_pen_x(const utxt_layout_glyph& lg)
+{
+    return lg.x - lg.glyph->bearing_x;
+}
+
+EXPORT utxt_layout_hit utxt_layout_hit_test(utxt_layout* layout_, float x, float y)
+{
+    auto& layout = *(Layout*)layout_;
+    update_current_line(layout);
+
+    // Last line that starts above y
+    const auto lines = std::span { layout.lines, layout.num_lines };
+    const auto line_it = std::partition_point(lines.begin(), lines.end(),
+        [y](const utxt_layout_line& line) { return line.y - line.ascent <= y; });
+    const auto line_idx = line_it == lines.begin() ? 0 : (size_t)(line_it - lines.begin()) - 1;
+    const auto& line = lines[line_idx];
+
+    if (!line.num_glyphs) {
+        return { line_idx, SIZE_MAX, line.first_glyph, line.text_offset };
+    }
+
+    const auto glyphs = std::span { layout.lglyphs + line.first_glyph, line.num_glyphs };
+    // The caret goes before the first glyph whose center is right of x
+    const auto caret = (size_t)(std::partition_point(glyphs.begin(), glyphs.end(),
+                                    [x](const utxt_layout_glyph& lg) {
+                                        return get_pen_x(lg) + lg.glyph->advance / 2.0f <= x;
+                                    })
+        - glyphs.begin());
+    const auto under = (size_t)(std::partition_point(glyphs.begin(), glyphs.end(),
+                                    [x](const utxt_layout_glyph& lg) { return get_pen_x(lg) <= x; })
+        - glyphs.begin());
+    const auto glyph = under > 0 ? under - 1 : 0;
+
+    size_t text_offset;
+    if (caret < glyphs.size()) {
+        text_offset = layout.glyph_text_offsets[line.first_glyph + caret];
+    } else {
+        const auto last = line.first_glyph + glyphs.size() - 1;
+        text_offset
+            = layout.glyph_text_offsets[last] + utf8_length(layout.lglyphs[last].glyph->codepoint);
+    }
+    return { line_idx, line.first_glyph + glyph, line.first_glyph + caret, text_offset };
+}
+
+EXPORT utxt_rect utxt_layout_glyph_rect(utxt_layout* layout_, size_t index)
+{
+    auto& layout = *(Layout*)layout_;
+    assert(index < layout.lglyph_idx);
+    update_current_line(layout);
+
+    // Last line that starts at or before index
+    const auto lines = std::span { layout.lines, layout.num_lines };
+    const auto line_it = std::partition_point(lines.begin(), lines.end(),
+        [index](const utxt_layout_line& line) { return line.first_glyph <= index; });
+    const auto& line = *(line_it - 1);
+
+    const auto& lg = layout.lglyphs[index];
+    return { get_pen_x(lg), line.y - line.ascent, lg.glyph->advance, line.height };
+}
+
 EXPORT void utxt_layout_glyph_get_quads(
     const utxt_layout_glyph* layout_glyphs, size_t num_glyphs, utxt_quad* quads, float x, float y)
 {
@@ -815,4 +2384,31 @@ EXPORT void utxt_layout_glyph_get_quads(
         quads[i] = { x + lg.x, y + lg.y, fg.width, fg.height, fg.u0, fg.v0, fg.u1, fg.v1 };
     }
 }
+
+EXPORT size_t utxt_layout_glyph_get_quads_clipped(const utxt_layout_glyph* layout_glyphs,
+    size_t num_glyphs, utxt_quad* quads, float x, float y, utxt_rect clip, utxt_clip_mode mode)
+{
+    size_t num_quads = 0;
+    for (size_t i = 0; i < num_glyphs; ++i) {
+        const auto& lg = layout_glyphs[i];
+        const auto& fg = *lg.glyph;
+        utxt_quad q { x + lg.x, y + lg.y, fg.width, fg.height, fg.u0, fg.v0, fg.u1, fg.v1 };
+        if (clip_quad(q, clip, mode)) {
+            quads[num_quads++] = q;
+        }
+    }
+    return num_quads;
+}
+
+EXPORT void utxt_layout_glyph_get_instances(const utxt_font* font,
+    const utxt_layout_glyph* layout_glyphs, size_t num_glyphs, utxt_glyph_instance* instances,
+    float x, float y)
+{
+    auto& fnt = *(Font*)font;
+    for (size_t i = 0; i < num_glyphs; ++i) {
+        const auto& lg = layout_glyphs[i];
+        assert(lg.glyph >= fnt.glyphs() && lg.glyph < fnt.glyphs() + get_num_glyphs(fnt));
+        instances[i] = { x + lg.x, y + lg.y, (uint32_t)(lg.glyph - fnt.glyphs()) };
+    }
+}
 }
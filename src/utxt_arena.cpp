@@ -0,0 +1,198 @@
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+
+#include "utxt_internal.h"
+
+namespace utxt {
+namespace {
+    // The data of a block follows its header in memory.
+    struct alignas(std::max_align_t) Block {
+        Block* next;
+        size_t capacity;
+        size_t offset; // sum of the capacities of all blocks before this one (see utxt_arena_mark)
+        size_t used;
+
+        uint8_t* data() { return (uint8_t*)(this + 1); }
+    };
+
+    struct Arena {
+        utxt_alloc backing;
+        size_t block_size = 0;
+        Block* first = nullptr;
+        Block* current = nullptr; // nullptr if nothing is allocated
+    };
+}
+
+constexpr size_t arena_alignment = alignof(std::max_align_t);
+constexpr size_t default_arena_block_size = 64 * 1024;
+
+static size_t align_up(size_t offset)
+{
+    return (offset + arena_alignment - 1) & ~(arena_alignment - 1);
+}
+
+static void update_offsets(Block* block, size_t offset)
+{
+    for (; block; block = block->next) {
+        block->offset = offset;
+        offset += block->capacity;
+    }
+}
+
+// Inserts a new block after prev (or at the front if prev is nullptr).
+static Block* insert_block(Arena& arena, Block* prev, size_t capacity)
+{
+    auto block = (Block*)arena.backing.realloc(
+        nullptr, 0, sizeof(Block) + capacity, arena.backing.ctx);
+    block->capacity = capacity;
+    block->used = 0;
+    auto& link = prev ? prev->next : arena.first;
+    block->next = link;
+    link = block;
+    update_offsets(block, prev ? prev->offset + prev->capacity : 0);
+    return block;
+}
+
+static Block* find_prev(const Arena& arena, const Block* block)
+{
+    Block* prev = nullptr;
+    for (auto b = arena.first; b != block; b = b->next) {
+        prev = b;
+    }
+    return prev;
+}
+
+static void* bump(Arena& arena, size_t size)
+{
+    if (auto block = arena.current) {
+        const auto offset = align_up(block->used);
+        if (offset + size <= block->capacity) {
+            block->used = offset + size;
+            return block->data() + offset;
+        }
+    }
+    // Blocks after the current one are left over from before the last reset and are reused.
+    auto block = arena.current ? arena.current->next : arena.first;
+    if (!block || block->capacity < size) {
+        // If everything in the current block was freed (e.g. the temporaries that followed a big
+        // allocation), the new block goes in front of it, so it is used next instead of skipped.
+        auto prev = arena.current;
+        if (prev && prev->used == 0) {
+            prev = find_prev(arena, prev);
+        }
+        block = insert_block(arena, prev, std::max(arena.block_size, align_up(size)));
+    }
+    block->used = size;
+    arena.current = block;
+    return block->data();
+}
+
+static void* arena_realloc(void* ptr, size_t old_size, size_t new_size, void* ctx)
+{
+    auto& arena = *(Arena*)ctx;
+    if (!ptr) {
+        return new_size ? bump(arena, new_size) : nullptr;
+    }
+
+    // The most recent allocation (or the one before it, after the most recent one was freed) can
+    // be resized and freed in place. It may be followed by up to alignment - 1 bytes of padding.
+    const auto block = arena.current;
+    const auto begin = (uint8_t*)ptr;
+    const auto in_block
+        = block && begin >= block->data() && begin < block->data() + block->capacity;
+    const auto offset = in_block ? (size_t)(begin - block->data()) : 0;
+    const auto is_last = in_block && offset + old_size <= block->used
+        && block->used <= align_up(offset + old_size);
+
+    if (!new_size) {
+        if (is_last) {
+            block->used = offset;
+        }
+        return nullptr;
+    }
+    if (is_last && offset + new_size <= block->capacity) {
+        block->used = offset + new_size;
+        return ptr;
+    }
+    if (new_size <= old_size) {
+        return ptr;
+    }
+    if (is_last && offset == 0) {
+        // The allocation has the block to itself (e.g. a big array that keeps growing), so the
+        // block is resized instead of leaving the old copy behind.
+        const auto prev = find_prev(arena, block);
+        const auto capacity = align_up(new_size);
+        auto new_block = (Block*)arena.backing.realloc(
+            block, sizeof(Block) + block->capacity, sizeof(Block) + capacity, arena.backing.ctx);
+        new_block->capacity = capacity;
+        new_block->used = new_size;
+        (prev ? prev->next : arena.first) = new_block;
+        arena.current = new_block;
+        update_offsets(new_block, new_block->offset);
+        return new_block->data();
+    }
+    auto new_ptr = bump(arena, new_size);
+    std::memcpy(new_ptr, ptr, old_size);
+    return new_ptr;
+}
+
+EXPORT utxt_arena* utxt_arena_create(utxt_alloc backing, size_t block_size)
+{
+    if (!backing.realloc) {
+        backing = { realloc, nullptr };
+    }
+    auto arena = allocate<Arena>(backing);
+    arena->backing = backing;
+    arena->block_size = align_up(block_size ? block_size : default_arena_block_size);
+    return (utxt_arena*)arena;
+}
+
+EXPORT void utxt_arena_free(utxt_arena* arena_)
+{
+    auto arena = (Arena*)arena_;
+    for (auto block = arena->first; block;) {
+        const auto next = block->next;
+        arena->backing.realloc(block, sizeof(Block) + block->capacity, 0, arena->backing.ctx);
+        block = next;
+    }
+    deallocate(arena->backing, arena);
+}
+
+EXPORT utxt_alloc utxt_arena_get_alloc(utxt_arena* arena)
+{
+    return { arena_realloc, arena };
+}
+
+EXPORT size_t utxt_arena_mark(const utxt_arena* arena_)
+{
+    auto& arena = *(const Arena*)arena_;
+    return arena.current ? arena.current->offset + arena.current->used : 0;
+}
+
+EXPORT void utxt_arena_reset(utxt_arena* arena_, size_t mark)
+{
+    auto& arena = *(Arena*)arena_;
+    assert(mark <= utxt_arena_mark(arena_));
+    if (!mark) {
+        arena.current = nullptr;
+        return;
+    }
+    auto block = arena.first;
+    while (mark > block->offset + block->capacity) {
+        block = block->next;
+    }
+    block->used = mark - block->offset;
+    arena.current = block;
+}
+
+EXPORT size_t utxt_arena_get_capacity(const utxt_arena* arena_)
+{
+    auto& arena = *(const Arena*)arena_;
+    size_t capacity = 0;
+    for (auto block = arena.first; block; block = block->next) {
+        capacity += block->capacity;
+    }
+    return capacity;
+}
+}
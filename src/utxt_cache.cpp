@@ -0,0 +1,195 @@
+#include <bit>
+#include <cassert>
+#include <cstring>
+
+#include "utxt_internal.h"
+
+namespace utxt {
+namespace {
+    // Allocated together with its glyphs and a copy of the text, which follow it in memory.
+    struct CacheEntry {
+        CacheEntry* lru_prev; // towards more recently used
+        CacheEntry* lru_next;
+        CacheEntry* bucket_next;
+        uint64_t hash;
+        const utxt_font* font;
+        float wrap_width;
+        utxt_text_align align;
+        size_t text_len;
+        size_t num_glyphs;
+        size_t size; // in bytes, including this header
+
+        utxt_layout_glyph* glyphs() { return (utxt_layout_glyph*)(this + 1); }
+        const char* text() { return (const char*)(glyphs() + num_glyphs); }
+    };
+    static_assert(sizeof(CacheEntry) % alignof(utxt_layout_glyph) == 0);
+
+    struct LayoutCache {
+        utxt_alloc alloc;
+        size_t memory_budget = 0;
+        size_t memory_used = 0;
+        CacheEntry** buckets = nullptr;
+        size_t num_buckets = 0; // power of two
+        size_t num_entries = 0;
+        CacheEntry* lru_first = nullptr; // most recently used
+        CacheEntry* lru_last = nullptr;
+        utxt_layout* layout = nullptr; // for misses
+    };
+}
+
+static uint64_t hash_key(
+    const utxt_font* font, utxt_string text, float wrap_width, utxt_text_align align)
+{
+    auto hash = hash_seed;
+    const auto font_addr = (uintptr_t)font;
+    const auto wrap_bits = std::bit_cast<uint32_t>(wrap_width);
+    const auto align_value = (uint32_t)align;
+    hash = hash_bytes(hash, &font_addr, sizeof(font_addr));
+    hash = hash_bytes(hash, &wrap_bits, sizeof(wrap_bits));
+    hash = hash_bytes(hash, &align_value, sizeof(align_value));
+    return hash_bytes(hash, text.data, text.len);
+}
+
+static void lru_unlink(LayoutCache& cache, CacheEntry* entry)
+{
+    (entry->lru_prev ? entry->lru_prev->lru_next : cache.lru_first) = entry->lru_next;
+    (entry->lru_next ? entry->lru_next->lru_prev : cache.lru_last) = entry->lru_prev;
+}
+
+static void lru_push_front(LayoutCache& cache, CacheEntry* entry)
+{
+    entry->lru_prev = nullptr;
+    entry->lru_next = cache.lru_first;
+    (cache.lru_first ? cache.lru_first->lru_prev : cache.lru_last) = entry;
+    cache.lru_first = entry;
+}
+
+static void remove_entry(LayoutCache& cache, CacheEntry* entry)
+{
+    auto link = &cache.buckets[entry->hash & (cache.num_buckets - 1)];
+    while (*link != entry) {
+        link = &(*link)->bucket_next;
+    }
+    *link = entry->bucket_next;
+    lru_unlink(cache, entry);
+    cache.memory_used -= entry->size;
+    cache.num_entries--;
+    cache.alloc.realloc(entry, entry->size, 0, cache.alloc.ctx);
+}
+
+static void grow_buckets(LayoutCache& cache)
+{
+    const auto new_num_buckets = std::max(cache.num_buckets * 2, (size_t)64);
+    auto new_buckets = allocate<CacheEntry*>(cache.alloc, new_num_buckets);
+    for (size_t b = 0; b < cache.num_buckets; ++b) {
+        for (auto entry = cache.buckets[b]; entry;) {
+            const auto next = entry->bucket_next;
+            auto& bucket = new_buckets[entry->hash & (new_num_buckets - 1)];
+            entry->bucket_next = bucket;
+            bucket = entry;
+            entry = next;
+        }
+    }
+    deallocate(cache.alloc, cache.buckets, cache.num_buckets);
+    cache.buckets = new_buckets;
+    cache.num_buckets = new_num_buckets;
+}
+
+EXPORT utxt_layout_cache* utxt_layout_cache_create(utxt_alloc alloc, size_t memory_budget)
+{
+    if (!alloc.realloc) {
+        alloc = { realloc, nullptr };
+    }
+    auto cache = allocate<LayoutCache>(alloc);
+    cache->alloc = alloc;
+    cache->memory_budget = memory_budget;
+    cache->layout = utxt_layout_create(alloc, 0);
+    utxt_layout_set_growth(cache->layout, UTXT_LAYOUT_GROWTH_GROW);
+    grow_buckets(*cache);
+    return (utxt_layout_cache*)cache;
+}
+
+EXPORT void utxt_layout_cache_clear(utxt_layout_cache* cache_)
+{
+    auto& cache = *(LayoutCache*)cache_;
+    while (cache.lru_last) {
+        remove_entry(cache, cache.lru_last);
+    }
+}
+
+EXPORT void utxt_layout_cache_free(utxt_layout_cache* cache_)
+{
+    auto cache = (LayoutCache*)cache_;
+    utxt_layout_cache_clear(cache_);
+    deallocate(cache->alloc, cache->buckets, cache->num_buckets);
+    utxt_layout_free(cache->layout);
+    deallocate(cache->alloc, cache);
+}
+
+EXPORT const utxt_layout_glyph* utxt_layout_cache_get(utxt_layout_cache* cache_,
+    const utxt_font* font, utxt_string text, float wrap_width, utxt_text_align align,
+    size_t* count)
+{
+    auto& cache = *(LayoutCache*)cache_;
+    const auto hash = hash_key(font, text, wrap_width, align);
+
+    for (auto entry = cache.buckets[hash & (cache.num_buckets - 1)]; entry;
+         entry = entry->bucket_next) {
+        if (entry->hash == hash && entry->font == font && entry->wrap_width == wrap_width
+            && entry->align == align && entry->text_len == text.len
+            && (!text.len || std::memcmp(entry->text(), text.data, text.len) == 0)) {
+            lru_unlink(cache, entry);
+            lru_push_front(cache, entry);
+            *count = entry->num_glyphs;
+            return entry->glyphs();
+        }
+    }
+
+    utxt_layout_reset(cache.layout, wrap_width, align);
+    utxt_layout_add_text(cache.layout, font, text);
+    utxt_layout_compute(cache.layout);
+    size_t num_glyphs = 0;
+    const auto glyphs = utxt_layout_get_glyphs(cache.layout, &num_glyphs);
+    *count = num_glyphs;
+
+    const auto size = sizeof(CacheEntry) + sizeof(utxt_layout_glyph) * num_glyphs + text.len;
+    if (size > cache.memory_budget) {
+        // Would evict everything else and not fit anyway
+        return glyphs;
+    }
+    while (cache.memory_used + size > cache.memory_budget) {
+        remove_entry(cache, cache.lru_last);
+    }
+    if (cache.num_entries >= cache.num_buckets) {
+        grow_buckets(cache);
+    }
+
+    auto entry = (CacheEntry*)cache.alloc.realloc(nullptr, 0, size, cache.alloc.ctx);
+    *entry = {
+        .lru_prev = nullptr,
+        .lru_next = nullptr,
+        .bucket_next = nullptr,
+        .hash = hash,
+        .font = font,
+        .wrap_width = wrap_width,
+        .align = align,
+        .text_len = text.len,
+        .num_glyphs = num_glyphs,
+        .size = size,
+    };
+    if (num_glyphs) {
+        std::memcpy(entry->glyphs(), glyphs, sizeof(utxt_layout_glyph) * num_glyphs);
+    }
+    if (text.len) {
+        std::memcpy((char*)entry->text(), text.data, text.len);
+    }
+
+    auto& bucket = cache.buckets[hash & (cache.num_buckets - 1)];
+    entry->bucket_next = bucket;
+    bucket = entry;
+    lru_push_front(cache, entry);
+    cache.memory_used += size;
+    cache.num_entries++;
+    return entry->glyphs();
+}
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include "utxt.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <thread>
+#include <type_traits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define UTXT_SSE2
+#include <emmintrin.h>
+#endif
+
+#define EXPORT extern "C"
+
+#if defined(_MSC_VER)
+#define UTXT_NOINLINE __declspec(noinline)
+#else
+#define UTXT_NOINLINE __attribute__((noinline))
+#endif
+
+namespace utxt {
+inline void* realloc(void* ptr, size_t, size_t new_size, void*)
+{
+    if (new_size) {
+        return std::realloc(ptr, new_size);
+    } else {
+        std::free(ptr);
+        return nullptr;
+    }
+}
+
+template <typename T>
+T* allocate(utxt_alloc alloc, size_t count = 1)
+{
+    auto ptr = (T*)alloc.realloc(nullptr, 0, sizeof(T) * count, alloc.ctx);
+    for (size_t i = 0; i < count; ++i) {
+        new (ptr + i) T {};
+    }
+    return ptr;
+}
+
+template <typename T>
+void deallocate(utxt_alloc alloc, T* ptr, size_t count = 1)
+{
+    if (!ptr) {
+        return;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        (ptr + i)->~T();
+    }
+    alloc.realloc(ptr, sizeof(T) * count, 0, alloc.ctx);
+}
+
+// Only for trivially copyable types, since the memory is moved by the allocator.
+template <typename T>
+T* reallocate(utxt_alloc alloc, T* ptr, size_t old_count, size_t new_count)
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+    return (T*)alloc.realloc(ptr, sizeof(T) * old_count, sizeof(T) * new_count, alloc.ctx);
+}
+
+// Blends a row of coverage values into a row of pixels with 1 or 4 channels (see utxt_render.cpp).
+using BlendRowFunc = void (*)(uint8_t* dst, const uint8_t* coverage, size_t n, utxt_color color);
+constexpr size_t max_blend_row_funcs = 3;
+
+// Writes every implementation (scalar, SSE2, AVX2) that the CPU supports to funcs, from slowest to
+// fastest, and returns their number. The renderer uses the last one, the others are for testing.
+size_t get_blend_row_funcs(uint32_t channels, BlendRowFunc* funcs);
+
+// Parallel arrays share one allocation (second after first), so they are resized with a single
+// realloc, which happens in place when the allocation is the last one in an arena.
+template <typename A, typename B>
+void resize_parallel(utxt_alloc alloc, A*& first, B*& second, size_t old_count, size_t new_count)
+{
+    static_assert(std::is_trivially_copyable_v<A> && std::is_trivially_copyable_v<B>);
+    static_assert(alignof(A) >= alignof(B) && sizeof(A) % alignof(B) == 0);
+    const auto keep = std::min(old_count, new_count);
+    auto data = (uint8_t*)first;
+    if (keep && new_count < old_count) {
+        std::memmove(data + sizeof(A) * new_count, second, sizeof(B) * keep);
+    }
+    data = (uint8_t*)alloc.realloc(
+        data, (sizeof(A) + sizeof(B)) * old_count, (sizeof(A) + sizeof(B)) * new_count, alloc.ctx);
+    if (keep && new_count > old_count) {
+        std::memmove(data + sizeof(A) * new_count, data + sizeof(A) * old_count, sizeof(B) * keep);
+    }
+    first = (A*)data;
+    second = new_count ? (B*)(data + sizeof(A) * new_count) : nullptr;
+}
+
+// FNV-1a, start with hash_seed
+constexpr uint64_t hash_seed = 0xcbf29ce484222325ull;
+
+inline uint64_t hash_bytes(uint64_t hash, const void* data, size_t size)
+{
+    const auto bytes = (const uint8_t*)data;
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+// Calls func(i) for every i in [0, count) on up to num_threads threads (0 means one per hardware
+// thread), including the calling thread. Indices are handed out one at a time, so func should do
+// a reasonable amount of work.
+template <typename Func>
+void parallel_for(utxt_alloc alloc, uint32_t num_threads, size_t count, Func&& func)
+{
+    if (!num_threads) {
+        num_threads = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+    num_threads = (uint32_t)std::min<size_t>(num_threads, count);
+
+    std::atomic<size_t> next { 0 };
+    auto worker = [&]() {
+        for (auto i = next.fetch_add(1, std::memory_order_relaxed); i < count;
+             i = next.fetch_add(1, std::memory_order_relaxed)) {
+            func(i);
+        }
+    };
+
+    if (num_threads <= 1) {
+        worker();
+        return;
+    }
+
+    const auto num_workers = num_threads - 1;
+    auto threads = allocate<std::thread>(alloc, num_workers);
+    for (size_t i = 0; i < num_workers; ++i) {
+        threads[i] = std::thread(worker);
+    }
+    worker();
+    for (size_t i = 0; i < num_workers; ++i) {
+        threads[i].join();
+    }
+    deallocate(alloc, threads, num_workers);
+}
+}
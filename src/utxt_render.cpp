@@ -0,0 +1,427 @@
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#include "utxt_internal.h"
+
+// With GCC and Clang we can compile the AVX2 kernels without enabling AVX2 for the whole library
+// and pick them at runtime. Otherwise we only use them if the compiler is targeting AVX2 anyway.
+#if defined(UTXT_SSE2) && (defined(__GNUC__) || defined(__clang__))
+#define UTXT_AVX2 __attribute__((target("avx2")))
+#define UTXT_AVX2_RUNTIME_CHECK
+#include <immintrin.h>
+#elif defined(__AVX2__)
+#define UTXT_AVX2
+#include <immintrin.h>
+#endif
+
+namespace utxt {
+namespace {
+    struct Atlas {
+        const uint8_t* data;
+        uint32_t width;
+        uint32_t height;
+        uint32_t channels;
+
+        // We use the last channel as coverage, so RGBA atlases use alpha.
+        uint8_t coverage(uint32_t x, uint32_t y) const
+        {
+            return data[(x + (size_t)y * width) * channels + channels - 1];
+        }
+    };
+
+    struct Rect {
+        int x0, y0, x1, y1; // x1, y1 exclusive
+    };
+
+    // A quad of a job in utxt_render_batch
+    struct QuadRef {
+        size_t job;
+        size_t quad;
+    };
+}
+
+// Exact for x in [0, 255 * 255]: (x + 128 + ((x + 128) >> 8)) >> 8 == round(x / 255)
+static uint32_t div255(uint32_t x)
+{
+    return (x + 128 + ((x + 128) >> 8)) >> 8;
+}
+
+// Single channel images accumulate coverage: dst = a + dst * (1 - a)
+// RGBA images use "over" blending with premultiplied alpha (the source color premultiplied is
+// color.rgb * a):
+//   dst.rgb = color.rgb * a + dst.rgb * (1 - a)
+//   dst.a = a + dst.a * (1 - a)
+// with a = coverage * color.a in both cases.
+
+static void blend_row_1_scalar(uint8_t* dst, const uint8_t* coverage, size_t n, utxt_color color)
+{
+    for (size_t i = 0; i < n; ++i) {
+        const auto a = div255(coverage[i] * color.a);
+        dst[i] = (uint8_t)(a + div255(dst[i] * (255 - a)));
+    }
+}
+
+static void blend_row_4_scalar(uint8_t* dst, const uint8_t* coverage, size_t n, utxt_color color)
+{
+    const uint32_t src[4] = { color.r, color.g, color.b, 255 };
+    for (size_t i = 0; i < n; ++i) {
+        const auto a = div255(coverage[i] * color.a);
+        for (size_t c = 0; c < 4; ++c) {
+            auto& d = dst[i * 4 + c];
+            d = (uint8_t)div255(src[c] * a + d * (255 - a));
+        }
+    }
+}
+
+#ifdef UTXT_SSE2
+static __m128i div255_sse2(__m128i x)
+{
+    const auto t = _mm_add_epi16(x, _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+// All values are 16 bit. Returns div255(src * a + dst * (255 - a)).
+static __m128i blend_sse2(__m128i src, __m128i dst, __m128i a)
+{
+    const auto inv_a = _mm_sub_epi16(_mm_set1_epi16(255), a);
+    return div255_sse2(_mm_add_epi16(_mm_mullo_epi16(src, a), _mm_mullo_epi16(dst, inv_a)));
+}
+
+static void blend_row_1_sse2(uint8_t* dst, const uint8_t* coverage, size_t n, utxt_color color)
+{
+    const auto zero = _mm_setzero_si128();
+    const auto alpha = _mm_set1_epi16(color.a);
+    const auto src = _mm_set1_epi16(255);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        const auto cov = _mm_loadu_si128((const __m128i*)(coverage + i));
+        const auto d = _mm_loadu_si128((const __m128i*)(dst + i));
+        const auto a_lo = div255_sse2(_mm_mullo_epi16(_mm_unpacklo_epi8(cov, zero), alpha));
+        const auto a_hi = div255_sse2(_mm_mullo_epi16(_mm_unpackhi_epi8(cov, zero), alpha));
+        const auto lo = blend_sse2(src, _mm_unpacklo_epi8(d, zero), a_lo);
+        const auto hi = blend_sse2(src, _mm_unpackhi_epi8(d, zero), a_hi);
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(lo, hi));
+    }
+    blend_row_1_scalar(dst + i, coverage + i, n - i, color);
+}
+
+static void blend_row_4_sse2(uint8_t* dst, const uint8_t* coverage, size_t n, utxt_color color)
+{
+    const auto zero = _mm_setzero_si128();
+    const auto alpha = _mm_set1_epi16(color.a);
+    const auto src = _mm_setr_epi16(color.r, color.g, color.b, 255, color.r, color.g, color.b, 255);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        // Replicate the coverage of each of the 4 pixels to all 4 of its channels
+        auto cov = _mm_cvtsi32_si128(
+            (int)(coverage[i] | coverage[i + 1] << 8 | coverage[i + 2] << 16
+                | (uint32_t)coverage[i + 3] << 24));
+        cov = _mm_unpacklo_epi8(cov, cov);
+        cov = _mm_unpacklo_epi16(cov, cov);
+        const auto d = _mm_loadu_si128((const __m128i*)(dst + i * 4));
+        const auto a_lo = div255_sse2(_mm_mullo_epi16(_mm_unpacklo_epi8(cov, zero), alpha));
+        const auto a_hi = div255_sse2(_mm_mullo_epi16(_mm_unpackhi_epi8(cov, zero), alpha));
+        const auto lo = blend_sse2(src, _mm_unpacklo_epi8(d, zero), a_lo);
+        const auto hi = blend_sse2(src, _mm_unpackhi_epi8(d, zero), a_hi);
+        _mm_storeu_si128((__m128i*)(dst + i * 4), _mm_packus_epi16(lo, hi));
+    }
+    blend_row_4_scalar(dst + i * 4, coverage + i, n - i, color);
+}
+#endif
+
+#ifdef UTXT_AVX2
+UTXT_AVX2 static __m256i div255_avx2(__m256i x)
+{
+    const auto t = _mm256_add_epi16(x, _mm256_set1_epi16(128));
+    return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+}
+
+UTXT_AVX2 static __m256i blend_avx2(__m256i src, __m256i dst, __m256i a)
+{
+    const auto inv_a = _mm256_sub_epi16(_mm256_set1_epi16(255), a);
+    return div255_avx2(
+        _mm256_add_epi16(_mm256_mullo_epi16(src, a), _mm256_mullo_epi16(dst, inv_a)));
+}
+
+// The unpacks and the pack below all work within 128 bit lanes, so they cancel each other out and
+// the pixel order is preserved.
+
+UTXT_AVX2 static void blend_row_1_avx2(
+    uint8_t* dst, const uint8_t* coverage, size_t n, utxt_color color)
+{
+    const auto zero = _mm256_setzero_si256();
+    const auto alpha = _mm256_set1_epi16(color.a);
+    const auto src = _mm256_set1_epi16(255);
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        const auto cov = _mm256_loadu_si256((const __m256i*)(coverage + i));
+        const auto d = _mm256_loadu_si256((const __m256i*)(dst + i));
+        const auto a_lo = div255_avx2(_mm256_mullo_epi16(_mm256_unpacklo_epi8(cov, zero), alpha));
+        const auto a_hi = div255_avx2(_mm256_mullo_epi16(_mm256_unpackhi_epi8(cov, zero), alpha));
+        const auto lo = blend_avx2(src, _mm256_unpacklo_epi8(d, zero), a_lo);
+        const auto hi = blend_avx2(src, _mm256_unpackhi_epi8(d, zero), a_hi);
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_packus_epi16(lo, hi));
+    }
+    blend_row_1_sse2(dst + i, coverage + i, n - i, color);
+}
+
+UTXT_AVX2 static void blend_row_4_avx2(
+    uint8_t* dst, const uint8_t* coverage, size_t n, utxt_color color)
+{
+    const auto zero = _mm256_setzero_si256();
+    const auto alpha = _mm256_set1_epi16(color.a);
+    const auto src = _mm256_setr_epi16(color.r, color.g, color.b, 255, color.r, color.g, color.b,
+        255, color.r, color.g, color.b, 255, color.r, color.g, color.b, 255);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        // Widen each coverage byte to 32 bit and replicate it to all 4 bytes (channels)
+        const auto cov8 = _mm_loadl_epi64((const __m128i*)(coverage + i));
+        const auto cov
+            = _mm256_mullo_epi32(_mm256_cvtepu8_epi32(cov8), _mm256_set1_epi32(0x01010101));
+        const auto d = _mm256_loadu_si256((const __m256i*)(dst + i * 4));
+        const auto a_lo = div255_avx2(_mm256_mullo_epi16(_mm256_unpacklo_epi8(cov, zero), alpha));
+        const auto a_hi = div255_avx2(_mm256_mullo_epi16(_mm256_unpackhi_epi8(cov, zero), alpha));
+        const auto lo = blend_avx2(src, _mm256_unpacklo_epi8(d, zero), a_lo);
+        const auto hi = blend_avx2(src, _mm256_unpackhi_epi8(d, zero), a_hi);
+        _mm256_storeu_si256((__m256i*)(dst + i * 4), _mm256_packus_epi16(lo, hi));
+    }
+    blend_row_4_sse2(dst + i * 4, coverage + i, n - i, color);
+}
+#endif
+
+#ifdef UTXT_AVX2
+static bool has_avx2()
+{
+#ifdef UTXT_AVX2_RUNTIME_CHECK
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    return avx2;
+#else
+    return true;
+#endif
+}
+#endif
+
+size_t get_blend_row_funcs(uint32_t channels, BlendRowFunc* funcs)
+{
+    assert(channels == 1 || channels == 4);
+    size_t count = 0;
+    funcs[count++] = channels == 1 ? blend_row_1_scalar : blend_row_4_scalar;
+#ifdef UTXT_SSE2
+    funcs[count++] = channels == 1 ? blend_row_1_sse2 : blend_row_4_sse2;
+#endif
+#ifdef UTXT_AVX2
+    if (has_avx2()) {
+        funcs[count++] = channels == 1 ? blend_row_1_avx2 : blend_row_4_avx2;
+    }
+#endif
+    return count;
+}
+
+static BlendRowFunc get_blend_row_func(uint32_t channels)
+{
+    BlendRowFunc funcs[max_blend_row_funcs];
+    return funcs[get_blend_row_funcs(channels, funcs) - 1];
+}
+
+// The pixels covered by the quad (offset by x, y), after snapping to whole pixels.
+static Rect snap_quad(const utxt_quad& quad, float x, float y)
+{
+    const auto qx = (int)std::lround(x + quad.x);
+    const auto qy = (int)std::lround(y + quad.y);
+    return { qx, qy, qx + (int)std::lround(quad.w), qy + (int)std::lround(quad.h) };
+}
+
+static void render_quad(const utxt_image& image, const Rect& clip, const Atlas& atlas,
+    const utxt_quad& quad, float x, float y, utxt_color color, BlendRowFunc blend_row)
+{
+    const auto pixels = snap_quad(quad, x, y);
+    const auto qx = pixels.x0;
+    const auto qy = pixels.y0;
+    const auto qw = pixels.x1 - pixels.x0;
+    const auto qh = pixels.y1 - pixels.y0;
+
+    const Rect dst {
+        std::max(qx, clip.x0),
+        std::max(qy, clip.y0),
+        std::min(pixels.x1, clip.x1),
+        std::min(pixels.y1, clip.y1),
+    };
+    if (dst.x0 >= dst.x1 || dst.y0 >= dst.y1) {
+        return;
+    }
+
+    // Region in the atlas
+    const auto ax = (int)std::lround(quad.u0 * (float)atlas.width);
+    const auto ay = (int)std::lround(quad.v0 * (float)atlas.height);
+    const auto aw = (int)std::lround((quad.u1 - quad.u0) * (float)atlas.width);
+    const auto ah = (int)std::lround((quad.v1 - quad.v0) * (float)atlas.height);
+    if (aw <= 0 || ah <= 0) {
+        return;
+    }
+    assert(ax >= 0 && ax + aw <= (int)atlas.width && ay >= 0 && ay + ah <= (int)atlas.height);
+
+    const auto channels = image.channels;
+    const auto stride = image.stride ? image.stride : image.width * channels;
+
+    // If the quad maps 1:1 to the atlas, we can blend directly from single channel atlas rows.
+    if (aw == qw && ah == qh && atlas.channels == 1) {
+        for (int py = dst.y0; py < dst.y1; ++py) {
+            const auto src = atlas.data + (size_t)(ay + py - qy) * atlas.width + ax + dst.x0 - qx;
+            const auto row = image.data + (size_t)py * stride + (size_t)dst.x0 * channels;
+            blend_row(row, src, (size_t)(dst.x1 - dst.x0), color);
+        }
+        return;
+    }
+
+    // Otherwise the quad is scaled relative to the atlas region (e.g. because of oversampling) and
+    // we box filter the footprint of each pixel into a coverage buffer first.
+    constexpr int chunk_size = 256;
+    uint8_t coverage[chunk_size];
+    for (int py = dst.y0; py < dst.y1; ++py) {
+        const auto sy0 = ay + (py - qy) * ah / qh;
+        const auto sy1 = std::max(ay + (py - qy + 1) * ah / qh, sy0 + 1);
+        const auto row = image.data + (size_t)py * stride;
+        for (int cx = dst.x0; cx < dst.x1; cx += chunk_size) {
+            const auto n = std::min(chunk_size, dst.x1 - cx);
+            for (int i = 0; i < n; ++i) {
+                const auto px = cx + i;
+                const auto sx0 = ax + (px - qx) * aw / qw;
+                const auto sx1 = std::max(ax + (px - qx + 1) * aw / qw, sx0 + 1);
+                uint32_t sum = 0;
+                for (int sy = sy0; sy < sy1; ++sy) {
+                    for (int sx = sx0; sx < sx1; ++sx) {
+                        sum += atlas.coverage((uint32_t)sx, (uint32_t)sy);
+                    }
+                }
+                coverage[i] = (uint8_t)(sum / (uint32_t)((sy1 - sy0) * (sx1 - sx0)));
+            }
+            blend_row(row + (size_t)cx * channels, coverage, (size_t)n, color);
+        }
+    }
+}
+
+static Rect get_clip_rect(const utxt_image& image, const utxt_rect* clip)
+{
+    Rect clip_rect { 0, 0, (int)image.width, (int)image.height };
+    if (clip) {
+        clip_rect.x0 = std::max(clip_rect.x0, (int)std::floor(clip->x));
+        clip_rect.y0 = std::max(clip_rect.y0, (int)std::floor(clip->y));
+        clip_rect.x1 = std::min(clip_rect.x1, (int)std::ceil(clip->x + clip->w));
+        clip_rect.y1 = std::min(clip_rect.y1, (int)std::ceil(clip->y + clip->h));
+    }
+    return clip_rect;
+}
+
+EXPORT void utxt_render_quads(utxt_image image, const utxt_font* font, const utxt_quad* quads,
+    size_t num_quads, float x, float y, utxt_color color, const utxt_rect* clip)
+{
+    Atlas atlas;
+    atlas.data = utxt_get_atlas(font, &atlas.width, &atlas.height, &atlas.channels);
+    assert(atlas.data);
+
+    const auto clip_rect = get_clip_rect(image, clip);
+    const auto blend_row = get_blend_row_func(image.channels);
+    for (size_t i = 0; i < num_quads; ++i) {
+        render_quad(image, clip_rect, atlas, quads[i], x, y, color, blend_row);
+    }
+}
+
+EXPORT void utxt_render_batch(utxt_image image, const utxt_font* font, const utxt_render_job* jobs,
+    size_t num_jobs, utxt_render_batch_params params)
+{
+    if (!params.alloc.realloc) {
+        params.alloc = { realloc, nullptr };
+    }
+    auto num_threads = params.num_threads;
+    if (!num_threads) {
+        num_threads = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+    const auto tile_size = params.tile_size ? (int)params.tile_size : 64;
+
+    Atlas atlas;
+    atlas.data = utxt_get_atlas(font, &atlas.width, &atlas.height, &atlas.channels);
+    assert(atlas.data);
+    const auto blend_row = get_blend_row_func(image.channels);
+
+    // Binning only pays off if the tiles are rendered in parallel.
+    if (num_threads == 1) {
+        const auto clip = get_clip_rect(image, nullptr);
+        for (size_t j = 0; j < num_jobs; ++j) {
+            const auto& job = jobs[j];
+            for (size_t q = 0; q < job.num_quads; ++q) {
+                render_quad(image, clip, atlas, job.quads[q], job.x, job.y, job.color, blend_row);
+            }
+        }
+        return;
+    }
+
+    const auto tiles_x = ((int)image.width + tile_size - 1) / tile_size;
+    const auto tiles_y = ((int)image.height + tile_size - 1) / tile_size;
+    const auto num_tiles = (size_t)(tiles_x * tiles_y);
+    if (num_tiles == 0 || num_jobs == 0) {
+        return;
+    }
+
+    // Calls func(tile, job, quad) for every tile that every quad overlaps, in job and quad order.
+    const auto for_each_quad_tile = [&](auto&& func) {
+        for (size_t j = 0; j < num_jobs; ++j) {
+            const auto& job = jobs[j];
+            for (size_t q = 0; q < job.num_quads; ++q) {
+                const auto pixels = snap_quad(job.quads[q], job.x, job.y);
+                if (pixels.x0 >= pixels.x1 || pixels.y0 >= pixels.y1) {
+                    continue;
+                }
+                const auto tx0 = std::max(pixels.x0, 0) / tile_size;
+                const auto ty0 = std::max(pixels.y0, 0) / tile_size;
+                const auto tx1
+                    = std::min((std::max(pixels.x1, 0) + tile_size - 1) / tile_size, tiles_x);
+                const auto ty1
+                    = std::min((std::max(pixels.y1, 0) + tile_size - 1) / tile_size, tiles_y);
+                for (int ty = ty0; ty < ty1; ++ty) {
+                    for (int tx = tx0; tx < tx1; ++tx) {
+                        func((size_t)(tx + ty * tiles_x), j, q);
+                    }
+                }
+            }
+        }
+    };
+
+    // Bin quads into tiles. Every tile gets a list of the quads overlapping it, in order, so they
+    // are still drawn in the order they were given. The lists are stored back to back (tile i has
+    // the quads tile_quads[tile_offsets[i]] to tile_quads[tile_offsets[i + 1]]).
+    auto tile_offsets = allocate<size_t>(params.alloc, num_tiles + 1);
+    for_each_quad_tile([&](size_t tile, size_t, size_t) { tile_offsets[tile + 1]++; });
+    for (size_t i = 0; i < num_tiles; ++i) {
+        tile_offsets[i + 1] += tile_offsets[i];
+    }
+
+    const auto num_entries = tile_offsets[num_tiles];
+    auto tile_quads = allocate<QuadRef>(params.alloc, num_entries);
+    auto tile_fill = allocate<size_t>(params.alloc, num_tiles);
+    for_each_quad_tile([&](size_t tile, size_t job, size_t quad) {
+        tile_quads[tile_offsets[tile] + tile_fill[tile]++] = { job, quad };
+    });
+
+    // Every tile is only touched by a single thread, so no synchronization is necessary.
+    parallel_for(params.alloc, num_threads, num_tiles, [&](size_t tile) {
+        const auto tx = (int)(tile % (size_t)tiles_x) * tile_size;
+        const auto ty = (int)(tile / (size_t)tiles_x) * tile_size;
+        const Rect clip {
+            tx,
+            ty,
+            std::min(tx + tile_size, (int)image.width),
+            std::min(ty + tile_size, (int)image.height),
+        };
+        for (auto e = tile_offsets[tile]; e < tile_offsets[tile + 1]; ++e) {
+            const auto& job = jobs[tile_quads[e].job];
+            render_quad(image, clip, atlas, job.quads[tile_quads[e].quad], job.x, job.y, job.color,
+                blend_row);
+        }
+    });
+
+    deallocate(params.alloc, tile_fill, num_tiles);
+    deallocate(params.alloc, tile_quads, num_entries);
+    deallocate(params.alloc, tile_offsets, num_tiles + 1);
+}
+}
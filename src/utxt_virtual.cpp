@@ -0,0 +1,198 @@
+#include <algorithm>
+#include <cassert>
+
+#include "utxt_internal.h"
+
+namespace utxt {
+namespace {
+    struct VirtualLayout {
+        utxt_alloc alloc;
+        const utxt_font* font = nullptr;
+        utxt_string text = {};
+        float wrap_width = 0.0f;
+        utxt_text_align align = UTXT_TEXT_ALIGN_LEFT;
+        float ascent = 0.0f;
+        // Both indexed by line, in the same allocation
+        double* ys = nullptr;
+        size_t* text_offsets = nullptr;
+        size_t num_lines = 0;
+        size_t lines_capacity = 0;
+        double height = 0.0;
+    };
+}
+
+// The text is laid out in chunks of about this many bytes, so we never hold glyphs for all of it.
+constexpr size_t virtual_chunk_size = 64 * 1024;
+
+static void push_line(VirtualLayout& layout, size_t text_offset, double y)
+{
+    if (layout.num_lines == layout.lines_capacity) {
+        const auto new_capacity = std::max(layout.lines_capacity * 2, (size_t)1024);
+        resize_parallel(
+            layout.alloc, layout.ys, layout.text_offsets, layout.lines_capacity, new_capacity);
+        layout.lines_capacity = new_capacity;
+    }
+    layout.text_offsets[layout.num_lines] = text_offset;
+    layout.ys[layout.num_lines] = y;
+    layout.num_lines++;
+}
+
+static bool is_whitespace_byte(char c)
+{
+    return c == ' ' || c == '\n' || c == '\r';
+}
+
+// Chunks end after whitespace, so they never split words (unless a word is longer than the chunk)
+// and never split UTF-8 sequences.
+static size_t get_chunk_end(utxt_string text, size_t start, size_t size)
+{
+    if (text.len - start <= size) {
+        return text.len;
+    }
+    for (auto end = start + size; end > start; --end) {
+        if (is_whitespace_byte(text.data[end - 1])) {
+            return end;
+        }
+    }
+    for (auto end = start + size; end < text.len; ++end) {
+        if (is_whitespace_byte(text.data[end])) {
+            return end + 1;
+        }
+    }
+    return text.len;
+}
+
+EXPORT utxt_virtual_layout* utxt_virtual_layout_create(utxt_alloc alloc)
+{
+    if (!alloc.realloc) {
+        alloc = { realloc, nullptr };
+    }
+    auto layout = allocate<VirtualLayout>(alloc);
+    layout->alloc = alloc;
+    return (utxt_virtual_layout*)layout;
+}
+
+EXPORT void utxt_virtual_layout_free(utxt_virtual_layout* layout_)
+{
+    auto layout = (VirtualLayout*)layout_;
+    resize_parallel(layout->alloc, layout->ys, layout->text_offsets, layout->lines_capacity, 0);
+    deallocate(layout->alloc, layout);
+}
+
+EXPORT void utxt_virtual_layout_set_text(utxt_virtual_layout* layout_, const utxt_font* font,
+    utxt_string text, float wrap_width, utxt_text_align align)
+{
+    auto& layout = *(VirtualLayout*)layout_;
+    layout.font = font;
+    layout.text = text;
+    layout.wrap_width = wrap_width;
+    layout.align = align;
+    layout.ascent = utxt_get_font_metrics(font)->ascent;
+    layout.num_lines = 0;
+
+    // Layout is deterministic from the start of every line (see utxt_layout_rewind), so we lay out
+    // a chunk, keep all lines except the last one (which might continue in the next chunk) and
+    // continue from the start of the last line. Alignment does not change line breaks.
+    auto chunk = utxt_layout_create(layout.alloc, 0);
+    utxt_layout_set_growth(chunk, UTXT_LAYOUT_GROWTH_GROW);
+    size_t start = 0;
+    double y = 0.0;
+    auto chunk_size = virtual_chunk_size;
+    while (true) {
+        const auto end = get_chunk_end(text, start, chunk_size);
+        utxt_layout_reset(chunk, wrap_width, UTXT_TEXT_ALIGN_LEFT);
+        utxt_layout_add_text(chunk, font, { text.data + start, end - start });
+        size_t num_lines = 0;
+        const auto lines = utxt_layout_get_lines(chunk, &num_lines);
+
+        if (end == text.len) {
+            for (size_t i = 0; i < num_lines; ++i) {
+                push_line(layout, start + lines[i].text_offset, y);
+                y += lines[i].height;
+            }
+            break;
+        }
+
+        if (num_lines == 1) {
+            // The whole chunk is a single line (e.g. no wrapping), so we need a bigger chunk.
+            chunk_size *= 2;
+            continue;
+        }
+
+        for (size_t i = 0; i + 1 < num_lines; ++i) {
+            push_line(layout, start + lines[i].text_offset, y);
+            y += lines[i].height;
+        }
+        start += lines[num_lines - 1].text_offset;
+        chunk_size = virtual_chunk_size;
+    }
+    layout.height = y;
+    utxt_layout_free(chunk);
+}
+
+EXPORT size_t utxt_virtual_layout_get_num_lines(const utxt_virtual_layout* layout_)
+{
+    auto& layout = *(const VirtualLayout*)layout_;
+    return layout.num_lines;
+}
+
+EXPORT double utxt_virtual_layout_get_height(const utxt_virtual_layout* layout_)
+{
+    auto& layout = *(const VirtualLayout*)layout_;
+    return layout.height;
+}
+
+EXPORT double utxt_virtual_layout_get_line_y(const utxt_virtual_layout* layout_, size_t line)
+{
+    auto& layout = *(const VirtualLayout*)layout_;
+    assert(line < layout.num_lines);
+    return layout.ys[line];
+}
+
+EXPORT size_t utxt_virtual_layout_get_line_text_offset(
+    const utxt_virtual_layout* layout_, size_t line)
+{
+    auto& layout = *(const VirtualLayout*)layout_;
+    assert(line < layout.num_lines);
+    return layout.text_offsets[line];
+}
+
+EXPORT size_t utxt_virtual_layout_find_line(const utxt_virtual_layout* layout_, double y)
+{
+    auto& layout = *(const VirtualLayout*)layout_;
+    const auto it = std::upper_bound(layout.ys, layout.ys + layout.num_lines, y + layout.ascent);
+    return it == layout.ys ? 0 : (size_t)(it - layout.ys) - 1;
+}
+
+EXPORT size_t utxt_virtual_layout_find_text_offset(
+    const utxt_virtual_layout* layout_, size_t text_offset)
+{
+    auto& layout = *(const VirtualLayout*)layout_;
+    const auto it = std::upper_bound(
+        layout.text_offsets, layout.text_offsets + layout.num_lines, text_offset);
+    return it == layout.text_offsets ? 0 : (size_t)(it - layout.text_offsets) - 1;
+}
+
+EXPORT size_t utxt_virtual_layout_materialize(const utxt_virtual_layout* layout_,
+    utxt_layout* dst, size_t first_line, size_t num_lines)
+{
+    auto& layout = *(const VirtualLayout*)layout_;
+    utxt_layout_reset(dst, layout.wrap_width, layout.align);
+    first_line = std::min(first_line, layout.num_lines);
+    num_lines = std::min(num_lines, layout.num_lines - first_line);
+    if (!num_lines) {
+        return 0;
+    }
+
+    const auto last_line = first_line + num_lines;
+    const auto begin = layout.text_offsets[first_line];
+    auto end = last_line < layout.num_lines ? layout.text_offsets[last_line] : layout.text.len;
+    // Don't start another (empty) line after the last one
+    if (last_line < layout.num_lines && end > begin && layout.text.data[end - 1] == '\n') {
+        end--;
+    }
+    utxt_layout_add_text(dst, layout.font, { layout.text.data + begin, end - begin });
+    utxt_layout_compute(dst);
+    return num_lines;
+}
+}
@@ -0,0 +1,1974 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <latch>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <utxt.h>
+
+#include "utxt_internal.h"
+
+// Most tests use fonts from many threads at once, so this is most useful with UTXT_ENABLE_TSAN.
+// Usage: utxt-test <path to a ttf file>
+
+constexpr size_t num_threads = 8;
+constexpr uint32_t image_width = 512;
+constexpr uint32_t image_height = 32;
+
+static std::atomic<size_t> num_failures { 0 };
+
+#define CHECK(cond)                                                                                \
+    do {                                                                                           \
+        if (!(cond)) {                                                                             \
+            std::fprintf(stderr, "%s:%d: Check failed: %s\n", __FILE__, __LINE__, #cond);         \
+            num_failures++;                                                                        \
+        }                                                                                          \
+    } while (0)
+
+static std::string_view get_last_error()
+{
+    const auto error = utxt_get_last_error();
+    return { error.data ? error.data : "", error.len };
+}
+
+static bool operator==(const utxt_quad& a, const utxt_quad& b)
+{
+    return a.x == b.x && a.y == b.y && a.w == b.w && a.h == b.h && a.u0 == b.u0 && a.v0 == b.v0
+        && a.u1 == b.u1 && a.v1 == b.v1;
+}
+
+static bool operator==(const utxt_layout_glyph& a, const utxt_layout_glyph& b)
+{
+    return a.glyph == b.glyph && a.x == b.x && a.y == b.y;
+}
+
+static bool operator==(const utxt_glyph& a, const utxt_glyph& b)
+{
+    return a.codepoint == b.codepoint && a.glyph_index == b.glyph_index
+        && a.bearing_x == b.bearing_x && a.bearing_y == b.bearing_y && a.width == b.width
+        && a.height == b.height && a.advance == b.advance && a.u0 == b.u0 && a.v0 == b.v0
+        && a.u1 == b.u1 && a.v1 == b.v1;
+}
+
+static bool operator==(const utxt_layout_line& a, const utxt_layout_line& b)
+{
+    return a.first_glyph == b.first_glyph && a.num_glyphs == b.num_glyphs
+        && a.text_offset == b.text_offset && a.x == b.x && a.y == b.y && a.width == b.width
+        && a.height == b.height && a.ascent == b.ascent;
+}
+
+static uint32_t next_random(uint32_t& rng)
+{
+    rng = rng * 1664525u + 1013904223u;
+    return rng >> 8;
+}
+
+static void append_utf8(std::vector<char>& text, uint32_t cp)
+{
+    if (cp < 0x80) {
+        text.push_back((char)cp);
+    } else if (cp < 0x800) {
+        text.push_back((char)(0xC0 | (cp >> 6)));
+        text.push_back((char)(0x80 | (cp & 0x3F)));
+    } else {
+        text.push_back((char)(0xE0 | (cp >> 12)));
+        text.push_back((char)(0x80 | ((cp >> 6) & 0x3F)));
+        text.push_back((char)(0x80 | (cp & 0x3F)));
+    }
+}
+
+// Words of mostly ASCII with some accents, Greek and code points that are not in the font (CJK),
+// separated by spaces and newlines, sometimes several of them. Some words are longer than a line.
+static std::vector<char> random_text(uint32_t& rng, size_t num_words)
+{
+    static const uint32_t code_points[] = { 'a', 'e', 'n', 's', 't', 'A', 'V', 'W', 'T', 'o', 'y',
+        '.', ',', '1', '7', 0xE9, 0xF6, 0x3B1, 0x3C9, 0x4E00 };
+    std::vector<char> text;
+    for (size_t w = 0; w < num_words; ++w) {
+        const auto length = next_random(rng) % 50 == 0 ? 100 + next_random(rng) % 100
+                                                        : 1 + next_random(rng) % 10;
+        for (size_t i = 0; i < length; ++i) {
+            append_utf8(text, code_points[next_random(rng) % std::size(code_points)]);
+        }
+        const auto separator = next_random(rng) % 16;
+        text.push_back(separator == 0 ? '\n' : ' ');
+        if (separator == 1) {
+            text.push_back(next_random(rng) % 2 ? '\n' : ' ');
+        }
+    }
+    return text;
+}
+
+// Everything utxt_layout_add_text produces, with glyphs as indices into the glyphs of the font, so
+// layouts with different copies of a font can be compared.
+struct LayoutContents {
+    struct Glyph {
+        size_t glyph;
+        float x, y;
+
+        bool operator==(const Glyph& other) const = default;
+    };
+    std::vector<Glyph> glyphs;
+    std::vector<size_t> text_offsets;
+    std::vector<utxt_layout_line> lines;
+
+    bool operator==(const LayoutContents& other) const = default;
+};
+
+static LayoutContents::Glyph get_layout_glyph(const utxt_layout_glyph& glyph, const utxt_font* font)
+{
+    size_t num_glyphs = 0;
+    return { (size_t)(glyph.glyph - utxt_get_glyphs(font, &num_glyphs)), glyph.x, glyph.y };
+}
+
+static LayoutContents get_layout_contents(utxt_layout* layout, const utxt_font* font)
+{
+    LayoutContents contents;
+    size_t count = 0;
+    const auto glyphs = utxt_layout_get_glyphs(layout, &count);
+    for (size_t i = 0; i < count; ++i) {
+        contents.glyphs.push_back(get_layout_glyph(glyphs[i], font));
+    }
+    const auto text_offsets = utxt_layout_get_glyph_text_offsets(layout, &count);
+    contents.text_offsets.assign(text_offsets, text_offsets + count);
+    const auto lines = utxt_layout_get_lines(layout, &count);
+    contents.lines.assign(lines, lines + count);
+    return contents;
+}
+
+// Lays out text with utxt_layout_add_text into a fresh layout. All other ways of laying out text
+// are compared with this.
+static LayoutContents get_reference_layout(const utxt_font* font, utxt_string text,
+    float wrap_width, utxt_text_align align)
+{
+    utxt_layout* layout = utxt_layout_create({}, (uint32_t)text.len + 1);
+    utxt_layout_reset(layout, wrap_width, align);
+    utxt_layout_add_text(layout, font, text);
+    utxt_layout_compute(layout);
+    auto contents = get_layout_contents(layout, font);
+    utxt_layout_free(layout);
+    return contents;
+}
+
+// Returns 0 at the end of the text. The text must be valid utf8.
+static uint32_t decode_utf8(utxt_string text, size_t& offset)
+{
+    if (offset >= text.len) {
+        return 0;
+    }
+    const auto u = (const uint8_t*)text.data + offset;
+    const auto length = u[0] < 0x80 ? 1 : u[0] < 0xE0 ? 2 : u[0] < 0xF0 ? 3 : 4;
+    uint32_t cp = length == 1 ? u[0] : u[0] & (0x3F >> (length - 1));
+    for (int i = 1; i < length; ++i) {
+        cp = (cp << 6) | (u[i] & 0x3F);
+    }
+    offset += (size_t)length;
+    return cp;
+}
+
+// The same glyphs as font with made up kerning between the glyphs of random_text, because the test
+// font has no kerning table.
+static utxt_font* create_kerned_font(const utxt_font* font)
+{
+    size_t num_glyphs = 0;
+    const auto glyphs = utxt_get_glyphs(font, &num_glyphs);
+    std::vector<utxt_kerning_pair> pairs;
+    const std::string_view kerned = "AVWTyo.,e";
+    for (size_t a = 0; a < num_glyphs; ++a) {
+        for (size_t b = 0; b < num_glyphs; ++b) {
+            const auto first = glyphs[a].codepoint, second = glyphs[b].codepoint;
+            if (first < 0x80 && second < 0x80 && kerned.find((char)first) != kerned.npos
+                && kerned.find((char)second) != kerned.npos && (first * 31 + second) % 4 != 0) {
+                const auto amount = -0.75f * (float)((first * 31 + second) % 4);
+                pairs.push_back({ glyphs[a].glyph_index, glyphs[b].glyph_index, amount });
+            }
+        }
+    }
+    std::sort(pairs.begin(), pairs.end(),
+        [](const utxt_kerning_pair& a, const utxt_kerning_pair& b) {
+            return a.first_glyph != b.first_glyph ? a.first_glyph < b.first_glyph
+                                                  : a.second_glyph < b.second_glyph;
+        });
+
+    utxt_font_create_params params {};
+    params.atlas_data = utxt_get_atlas(
+        font, &params.atlas_width, &params.atlas_height, &params.atlas_channels);
+    params.metrics = *utxt_get_font_metrics(font);
+    params.glyphs = glyphs;
+    params.num_glyphs = num_glyphs;
+    params.kerning_pairs = pairs.data();
+    params.num_kerning_pairs = pairs.size();
+    return utxt_font_create({}, params);
+}
+
+// Straightforward model of utxt_layout_add_text with left alignment, without lines, so the glyphs
+// are checked against something that was not derived from the layout code. Words that don't fit
+// go to the next line, unless they are at its start. With wrap_glyphs, it models
+// utxt_layout_add_glyphs instead, which wraps every glyph on its own.
+static LayoutContents get_model_layout(
+    const utxt_font* font, utxt_string text, float wrap_width, bool wrap_glyphs = false)
+{
+    size_t num_font_glyphs = 0;
+    const auto font_glyphs = utxt_get_glyphs(font, &num_font_glyphs);
+    const auto line_height = utxt_get_font_metrics(font)->line_height;
+    const auto space_advance = utxt_find_glyph(font, ' ')->advance;
+
+    struct WordGlyph {
+        const utxt_glyph* glyph;
+        float x;
+        size_t text_offset;
+    };
+    std::vector<WordGlyph> word;
+    float word_advance = 0.0f;
+    uint32_t prev_glyph_index = 0;
+    float cursor_x = 0.0f, cursor_y = 0.0f;
+    LayoutContents contents;
+
+    const auto end_word = [&] {
+        if (word.empty()) {
+            return;
+        }
+        const auto start = word.front().x - word.front().glyph->bearing_x;
+        const auto width = word.back().x + word.back().glyph->width - start;
+        if (cursor_x > 0.0f && cursor_x + width > wrap_width) {
+            cursor_x = 0.0f;
+            cursor_y += line_height;
+        }
+        for (const auto& g : word) {
+            contents.glyphs.push_back({ (size_t)(g.glyph - font_glyphs), g.x + cursor_x,
+                g.glyph->bearing_y + cursor_y });
+            contents.text_offsets.push_back(g.text_offset);
+        }
+        cursor_x += word_advance;
+        word.clear();
+        word_advance = 0.0f;
+    };
+
+    for (size_t offset = 0; offset < text.len;) {
+        const auto text_offset = offset;
+        const auto cp = decode_utf8(text, offset);
+        if (cp == ' ' || cp == '\n' || cp == '\r') {
+            end_word();
+            if (cp == '\n') {
+                cursor_x = 0.0f;
+                cursor_y += line_height;
+            } else if (cp == ' ' && cursor_x > 0.0f) {
+                cursor_x += space_advance;
+            }
+            prev_glyph_index = 0;
+            continue;
+        }
+        const auto glyph = utxt_find_glyph(font, cp);
+        if (!glyph) {
+            prev_glyph_index = 0;
+            continue;
+        }
+        if (wrap_glyphs) {
+            auto x = cursor_x;
+            if (prev_glyph_index) {
+                x += utxt_get_kerning(font, prev_glyph_index, glyph->glyph_index);
+            }
+            if (x > 0.0f && x + glyph->bearing_x + glyph->width > wrap_width) {
+                x = 0.0f;
+                cursor_y += line_height;
+            }
+            contents.glyphs.push_back({ (size_t)(glyph - font_glyphs), x + glyph->bearing_x,
+                glyph->bearing_y + cursor_y });
+            contents.text_offsets.push_back(text_offset);
+            cursor_x = x + glyph->advance;
+            prev_glyph_index = glyph->glyph_index;
+            continue;
+        }
+        if (prev_glyph_index) {
+            word_advance += utxt_get_kerning(font, prev_glyph_index, glyph->glyph_index);
+        }
+        prev_glyph_index = glyph->glyph_index;
+        word.push_back({ glyph, word_advance + glyph->bearing_x, text_offset });
+        word_advance += glyph->advance;
+    }
+    end_word();
+    return contents;
+}
+
+static std::vector<uint8_t> read_file(const char* path)
+{
+    std::vector<uint8_t> data;
+    auto file = std::fopen(path, "rb");
+    if (!file) {
+        return data;
+    }
+    uint8_t buffer[4096];
+    size_t n = 0;
+    while ((n = std::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        data.insert(data.end(), buffer, buffer + n);
+    }
+    std::fclose(file);
+    return data;
+}
+
+// Everything a thread computes from the font, to compare it with the other threads.
+struct TextResults {
+    std::vector<utxt_quad> quads;
+    std::vector<utxt_layout_glyph> layout_glyphs;
+    std::vector<uint8_t> pixels;
+    utxt_text_size size;
+    float width;
+};
+
+static TextResults get_text_results(const utxt_font* font, utxt_string text)
+{
+    TextResults results;
+    results.quads.resize(text.len);
+    results.quads.resize(utxt_draw_text(results.quads.data(), text.len, font, text, 5.0f, 7.0f));
+
+    utxt_layout* layout = utxt_layout_create({}, (uint32_t)text.len);
+    utxt_layout_reset(layout, 200.0f, UTXT_TEXT_ALIGN_CENTER);
+    utxt_layout_add_text(layout, font, text);
+    utxt_layout_compute(layout);
+    size_t num_glyphs = 0;
+    const auto glyphs = utxt_layout_get_glyphs(layout, &num_glyphs);
+    results.layout_glyphs.assign(glyphs, glyphs + num_glyphs);
+    utxt_layout_free(layout);
+
+    results.pixels.resize(image_width * image_height);
+    const utxt_image image { results.pixels.data(), image_width, image_height, 1 };
+    utxt_render_quads(image, font, results.quads.data(), results.quads.size(), 0.0f, 10.0f,
+        { 255, 255, 255, 255 }, nullptr);
+
+    results.size = utxt_measure_text(font, text, 200.0f);
+    results.width = utxt_get_text_width(font, text);
+    return results;
+}
+
+static bool operator==(const TextResults& a, const TextResults& b)
+{
+    return a.quads == b.quads && a.layout_glyphs == b.layout_glyphs && a.pixels == b.pixels
+        && a.size.width == b.size.width && a.size.height == b.size.height
+        && a.size.num_lines == b.size.num_lines && a.width == b.width;
+}
+
+// Every thread fails a different call (or none), then uses the same font as all the others.
+static void test_shared_font(const std::vector<uint8_t>& ttf)
+{
+    utxt_font* font = utxt_font_load_ttf_buffer(
+        {}, ttf.data(), ttf.size(), { .size = 20, .atlas_size = 512 });
+    CHECK(font);
+    if (!font) {
+        return;
+    }
+
+    // Split where a hex escape would otherwise continue into the next letter
+    const utxt_string text = UTXT_LITERAL("The quick brown fox jumps over the lazy dog.\n"
+                                          "P\xC3\xA4" "ck my b\xC3\xB6x with f\xC3\xAD" "ve dozen "
+                                          "liquor jugs! 0123456789 (AVAWAY) {tT} [iIlL]");
+    const auto expected = get_text_results(font, text);
+    alignas(8) const uint8_t bad_blob[64] = {};
+
+    std::latch errors_set { num_threads };
+    std::latch work_done { num_threads };
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < num_threads; ++t) {
+        threads.emplace_back([&, t] {
+            std::string_view expected_error;
+            switch (t % 4) {
+            case 0:
+                break;
+            case 1:
+                CHECK(!utxt_font_load_ttf({}, "this file does not exist.ttf", {}));
+                expected_error = "Could not read file";
+                break;
+            case 2:
+                CHECK(!utxt_font_from_blob(bad_blob, sizeof(bad_blob)));
+                expected_error = "Invalid font blob";
+                break;
+            case 3:
+                CHECK(!utxt_font_load_ttf_buffer({}, ttf.data(), ttf.size(), { .font_index = 7 }));
+                expected_error = "Font index out of range";
+                break;
+            }
+            CHECK(get_last_error() == expected_error);
+            errors_set.arrive_and_wait();
+
+            for (size_t i = 0; i < 20; ++i) {
+                CHECK(get_text_results(font, text) == expected);
+            }
+            work_done.arrive_and_wait();
+
+            // All threads have set their errors and used the font in the meantime
+            CHECK(get_last_error() == expected_error);
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    utxt_font_free(font);
+}
+
+// Every thread lays out the same code points in a different order, so they keep missing the same
+// glyphs at the same time. Every code point must end up with exactly one glyph, which all threads
+// see with the same data.
+static void test_dynamic_font(const std::vector<uint8_t>& ttf)
+{
+    utxt_font* font = utxt_font_create_dynamic({}, ttf.data(), ttf.size(), { .size = 20 });
+    CHECK(font);
+    if (!font) {
+        return;
+    }
+
+    // Latin, Greek and Cyrillic, and some CJK that is not in the font
+    const uint32_t ranges[][2] = {
+        { 0x21, 0x24F },
+        { 0x370, 0x4FF },
+        { 0x4E00, 0x4E3F },
+    };
+    std::vector<uint32_t> code_points;
+    for (const auto& range : ranges) {
+        for (uint32_t cp = range[0]; cp <= range[1]; ++cp) {
+            code_points.push_back(cp);
+        }
+    }
+    const auto max_cp = code_points.back();
+
+    struct SeenGlyph {
+        const utxt_glyph* glyph = nullptr;
+        utxt_glyph data = {};
+    };
+    std::vector<std::vector<SeenGlyph>> seen(num_threads, std::vector<SeenGlyph>(max_cp + 1));
+
+    std::latch start { num_threads };
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < num_threads; ++t) {
+        threads.emplace_back([&, t] {
+            auto order = code_points;
+            uint32_t rng = (uint32_t)t * 7919u + 1;
+            for (size_t i = order.size() - 1; i > 0; --i) {
+                rng = rng * 1664525u + 1013904223u;
+                std::swap(order[i], order[(rng >> 8) % (i + 1)]);
+            }
+
+            utxt_layout* layout = utxt_layout_create({}, 0);
+            utxt_layout_set_growth(layout, UTXT_LAYOUT_GROWTH_GROW);
+            start.arrive_and_wait();
+
+            // A few code points at a time, so the threads race on every glyph
+            for (size_t first = 0; first < order.size(); first += 16) {
+                std::vector<char> text;
+                for (size_t i = first; i < std::min(first + 16, order.size()); ++i) {
+                    append_utf8(text, order[i]);
+                }
+                utxt_layout_reset(layout, 0.0f, UTXT_TEXT_ALIGN_LEFT);
+                utxt_layout_add_text(layout, font, { text.data(), text.size() });
+                utxt_layout_compute(layout);
+
+                size_t num_glyphs = 0;
+                const auto glyphs = utxt_layout_get_glyphs(layout, &num_glyphs);
+                for (size_t i = 0; i < num_glyphs; ++i) {
+                    const auto glyph = glyphs[i].glyph;
+                    CHECK(glyph->codepoint <= max_cp);
+                    if (glyph->codepoint > max_cp) {
+                        continue;
+                    }
+                    auto& s = seen[t][glyph->codepoint];
+                    CHECK(!s.glyph || s.glyph == glyph);
+                    s = { glyph, *glyph };
+                }
+            }
+            utxt_layout_free(layout);
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    size_t num_glyphs = 0;
+    const auto glyphs = utxt_get_glyphs(font, &num_glyphs);
+    CHECK(num_glyphs > 0);
+    CHECK(utxt_get_atlas_version(font) > 0);
+
+    std::vector<size_t> glyphs_per_cp(max_cp + 1);
+    for (size_t i = 0; i < num_glyphs; ++i) {
+        CHECK(glyphs[i].codepoint <= max_cp);
+        if (glyphs[i].codepoint <= max_cp) {
+            glyphs_per_cp[glyphs[i].codepoint]++;
+        }
+    }
+    for (const auto cp : code_points) {
+        CHECK(glyphs_per_cp[cp] <= 1);
+        // Every thread saw the same glyph as the font has, with the same data
+        for (size_t t = 0; t < num_threads; ++t) {
+            const auto& s = seen[t][cp];
+            CHECK((s.glyph != nullptr) == (glyphs_per_cp[cp] == 1));
+            if (s.glyph) {
+                CHECK(s.glyph >= glyphs && s.glyph < glyphs + num_glyphs);
+                CHECK(s.data == *s.glyph);
+            }
+        }
+    }
+    CHECK(glyphs_per_cp[0x41] == 1); // 'A'
+    CHECK(glyphs_per_cp[0x4E00] == 0); // not in the font
+
+    utxt_font_free(font);
+}
+
+// Measuring must only add the glyphs that are measured to a dynamic font, or small fonts fill up.
+static void test_dynamic_font_widths(const std::vector<uint8_t>& ttf)
+{
+    utxt_font* font
+        = utxt_font_create_dynamic({}, ttf.data(), ttf.size(), { .size = 20, .max_glyphs = 64 });
+    CHECK(font);
+    if (!font) {
+        return;
+    }
+
+    const utxt_string texts[] = {
+        UTXT_LITERAL("\xC3\xA9\xC3\xA8"),
+        UTXT_LITERAL("\xC3\xA9t\xC3\xA9"),
+        UTXT_LITERAL(""),
+    };
+    float widths[std::size(texts)];
+    utxt_get_text_widths(font, texts, widths, std::size(texts), {});
+
+    size_t num_glyphs = 0;
+    utxt_get_glyphs(font, &num_glyphs);
+    CHECK(num_glyphs == 3);
+    CHECK(utxt_get_atlas_version(font) <= 3);
+    CHECK(widths[0] > 0.0f);
+    CHECK(widths[1] > widths[0]);
+    CHECK(widths[2] == 0.0f);
+    for (size_t i = 0; i < std::size(texts); ++i) {
+        CHECK(widths[i] == utxt_get_text_width(font, texts[i]));
+    }
+
+    // There is still room for other glyphs
+    CHECK(utxt_get_text_width(font, UTXT_LITERAL("\xD0\x96")) > 0.0f); // Cyrillic Zhe
+    utxt_font_free(font);
+}
+
+// A font must work the same from a copy of its blob, and blobs that are truncated, misaligned,
+// corrupted or of dynamic fonts must be rejected.
+static void test_font_blob(const std::vector<uint8_t>& ttf)
+{
+    utxt_font* font
+        = utxt_font_load_ttf_buffer({}, ttf.data(), ttf.size(), { .size = 20, .atlas_size = 512 });
+    CHECK(font);
+    if (!font) {
+        return;
+    }
+    utxt_font* kerned_font = create_kerned_font(font);
+
+    uint32_t rng = 14;
+    const auto text = random_text(rng, 300);
+    const utxt_string str { text.data(), text.size() };
+    for (const utxt_font* f : { (const utxt_font*)font, (const utxt_font*)kerned_font }) {
+        size_t size = 0;
+        const auto blob = utxt_font_get_blob(f, &size);
+        CHECK(blob == (const void*)f);
+        // One extra word, so the copy can be misaligned
+        std::vector<uint64_t> copy(size / sizeof(uint64_t) + 2);
+        std::memcpy(copy.data(), blob, size);
+        const auto loaded = utxt_font_from_blob(copy.data(), size);
+        CHECK(loaded);
+        if (!loaded) {
+            continue;
+        }
+
+        size_t loaded_size = 0;
+        CHECK(utxt_font_get_blob(loaded, &loaded_size) == copy.data() && loaded_size == size);
+        const auto metrics = utxt_get_font_metrics(f);
+        const auto loaded_metrics = utxt_get_font_metrics(loaded);
+        CHECK(metrics->ascent == loaded_metrics->ascent
+            && metrics->descent == loaded_metrics->descent
+            && metrics->line_gap == loaded_metrics->line_gap
+            && metrics->line_height == loaded_metrics->line_height);
+        size_t num_glyphs = 0, num_loaded_glyphs = 0;
+        const auto glyphs = utxt_get_glyphs(f, &num_glyphs);
+        const auto loaded_glyphs = utxt_get_glyphs(loaded, &num_loaded_glyphs);
+        CHECK(std::equal(
+            glyphs, glyphs + num_glyphs, loaded_glyphs, loaded_glyphs + num_loaded_glyphs));
+        CHECK(utxt_find_glyph(loaded, 'A') == loaded_glyphs + (utxt_find_glyph(f, 'A') - glyphs));
+        CHECK(utxt_get_kerning(loaded, glyphs[0].glyph_index, glyphs[1].glyph_index)
+            == utxt_get_kerning(f, glyphs[0].glyph_index, glyphs[1].glyph_index));
+        uint32_t width, height, channels, loaded_width, loaded_height, loaded_channels;
+        const auto atlas = utxt_get_atlas(f, &width, &height, &channels);
+        const auto loaded_atlas
+            = utxt_get_atlas(loaded, &loaded_width, &loaded_height, &loaded_channels);
+        CHECK(width == loaded_width && height == loaded_height && channels == loaded_channels);
+        CHECK(std::memcmp(atlas, loaded_atlas, (size_t)width * height * channels) == 0);
+        CHECK(get_reference_layout(loaded, str, 300.0f, UTXT_TEXT_ALIGN_CENTER)
+            == get_reference_layout(f, str, 300.0f, UTXT_TEXT_ALIGN_CENTER));
+
+        for (const auto truncated : { (size_t)0, (size_t)16, size / 2, size - 1 }) {
+            CHECK(!utxt_font_from_blob(copy.data(), truncated));
+            CHECK(!get_last_error().empty());
+        }
+        const auto misaligned = (uint8_t*)copy.data() + 4;
+        std::memmove(misaligned, copy.data(), size);
+        CHECK(!utxt_font_from_blob(misaligned, size));
+        std::memmove(copy.data(), misaligned, size);
+        CHECK(utxt_font_from_blob(copy.data(), size));
+        std::memset(copy.data(), 0, sizeof(uint64_t));
+        CHECK(!utxt_font_from_blob(copy.data(), size));
+    }
+    utxt_font_free(kerned_font);
+    utxt_font_free(font);
+
+    // Dynamic fonts point to their TTF and rasterizer state
+    utxt_font* dynamic
+        = utxt_font_create_dynamic({}, ttf.data(), ttf.size(), { .size = 20, .max_glyphs = 64 });
+    CHECK(dynamic);
+    if (!dynamic) {
+        return;
+    }
+    CHECK(utxt_get_text_width(dynamic, UTXT_LITERAL("Blob")) > 0.0f);
+    size_t size = 0;
+    const auto blob = utxt_font_get_blob(dynamic, &size);
+    std::vector<uint64_t> copy((size + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+    std::memcpy(copy.data(), blob, size);
+    CHECK(!utxt_font_from_blob(copy.data(), size));
+    CHECK(get_last_error() == "Dynamic fonts can not be used as blobs");
+    utxt_font_free(dynamic);
+}
+
+// Glyphs that extend beyond the font's ascent or descent must still be drawn where they overlap the
+// clip rect, even if the line between ascent and descent does not.
+static void test_draw_text_clipped()
+{
+    const utxt_glyph glyphs[] = {
+        // Reaches 20 above the baseline, 10 above the ascent
+        { 'A', 1, 0.0f, -20.0f, 8.0f, 25.0f, 10.0f, 0.0f, 0.0f, 0.5f, 1.0f },
+        // Reaches 20 below the baseline, 15 below the descent
+        { 'g', 2, 0.0f, 0.0f, 8.0f, 20.0f, 10.0f, 0.5f, 0.0f, 1.0f, 1.0f },
+    };
+    utxt_font_create_params params {};
+    params.metrics = { 10.0f, -5.0f, 0.0f, 15.0f };
+    params.glyphs = glyphs;
+    params.num_glyphs = std::size(glyphs);
+    utxt_font* font = utxt_font_create({}, params);
+    CHECK(font);
+    if (!font) {
+        return;
+    }
+
+    const utxt_string text = UTXT_LITERAL("Ag");
+    utxt_quad quads[2];
+    auto draw = [&](utxt_rect clip, utxt_clip_mode mode) {
+        return utxt_draw_text_clipped(quads, 2, font, text, 0.0f, 50.0f, clip, mode);
+    };
+    // Above the ascent
+    CHECK(draw({ 0, 0, 100, 35 }, UTXT_CLIP_CULL) == 1);
+    CHECK(quads[0] == (utxt_quad { 0.0f, 30.0f, 8.0f, 25.0f, 0.0f, 0.0f, 0.5f, 1.0f }));
+    // Below the descent, cropped to the clip rect
+    CHECK(draw({ 0, 60, 100, 10 }, UTXT_CLIP_CROP) == 1);
+    CHECK(quads[0] == (utxt_quad { 10.0f, 60.0f, 8.0f, 10.0f, 0.5f, 0.5f, 1.0f, 1.0f }));
+    // Beyond both glyphs
+    CHECK(draw({ 0, 0, 100, 30 }, UTXT_CLIP_CULL) == 0);
+    CHECK(draw({ 0, 70, 100, 10 }, UTXT_CLIP_CULL) == 0);
+    utxt_font_free(font);
+}
+
+// All blending implementations must produce the same bytes, also over pixels that are not opaque.
+static void test_blend_row_funcs()
+{
+    uint32_t rng = 12345;
+    const auto next_byte = [&rng] {
+        rng = rng * 1664525u + 1013904223u;
+        return (uint8_t)(rng >> 24);
+    };
+
+    for (const uint32_t channels : { 1u, 4u }) {
+        utxt::BlendRowFunc funcs[utxt::max_blend_row_funcs];
+        const auto num_funcs = utxt::get_blend_row_funcs(channels, funcs);
+
+        // Sizes that end in every possible tail of the vectorized loops
+        for (size_t n = 0; n < 70; ++n) {
+            std::vector<uint8_t> coverage(n);
+            std::vector<uint8_t> pixels(n * channels);
+            for (auto& c : coverage) {
+                c = next_byte();
+            }
+            for (auto& p : pixels) {
+                p = next_byte();
+            }
+            // Fully transparent, fully covered and fully opaque source colors too
+            const utxt_color colors[] = {
+                { next_byte(), next_byte(), next_byte(), next_byte() },
+                { 10, 200, 30, 0 },
+                { 255, 128, 0, 255 },
+            };
+            for (const auto color : colors) {
+                auto expected = pixels;
+                funcs[0](expected.data(), coverage.data(), n, color);
+                for (size_t f = 1; f < num_funcs; ++f) {
+                    auto result = pixels;
+                    funcs[f](result.data(), coverage.data(), n, color);
+                    CHECK(result == expected);
+                }
+            }
+        }
+    }
+
+    // Premultiplied: white at 50% coverage over a transparent pixel
+    utxt::BlendRowFunc funcs[utxt::max_blend_row_funcs];
+    const auto num_funcs = utxt::get_blend_row_funcs(4, funcs);
+    for (size_t f = 0; f < num_funcs; ++f) {
+        uint8_t pixels[8 * 4] = {};
+        uint8_t coverage[8];
+        std::memset(coverage, 128, sizeof(coverage));
+        funcs[f](pixels, coverage, 8, { 255, 255, 255, 255 });
+        for (const auto p : pixels) {
+            CHECK(p == 128);
+        }
+    }
+}
+
+// Batches must render exactly like utxt_render_quads for each job in order, also where labels
+// overlap each other and the tile borders.
+static void test_render_batch(const std::vector<uint8_t>& ttf)
+{
+    utxt_font* font
+        = utxt_font_load_ttf_buffer({}, ttf.data(), ttf.size(), { .size = 20, .atlas_size = 512 });
+    CHECK(font);
+    if (!font) {
+        return;
+    }
+
+    const utxt_string label = UTXT_LITERAL("Label 1234");
+    std::vector<utxt_quad> quads(label.len);
+    quads.resize(utxt_draw_text(quads.data(), quads.size(), font, label, 0.0f, 0.0f));
+
+    const uint32_t width = 300, height = 200;
+    std::vector<utxt_render_job> jobs;
+    uint32_t rng = 12345;
+    for (size_t i = 0; i < 200; ++i) {
+        rng = rng * 1664525u + 1013904223u;
+        const auto x = (float)(rng % (width + 100)) - 80.0f;
+        rng = rng * 1664525u + 1013904223u;
+        const auto y = (float)(rng % (height + 40)) - 20.0f;
+        const auto c = (uint8_t)(rng >> 24);
+        jobs.push_back({ quads.data(), quads.size(), x, y, { c, 100, 255, (uint8_t)(c | 64) } });
+    }
+
+    for (const uint32_t channels : { 1u, 4u }) {
+        std::vector<uint8_t> expected(width * height * channels, 20);
+        const utxt_image expected_image { expected.data(), width, height, channels };
+        for (const auto& job : jobs) {
+            utxt_render_quads(
+                expected_image, font, job.quads, job.num_quads, job.x, job.y, job.color, nullptr);
+        }
+
+        for (const uint32_t num_threads : { 1u, 3u }) {
+            for (const uint32_t tile_size : { 0u, 7u, 64u }) {
+                std::vector<uint8_t> pixels(width * height * channels, 20);
+                const utxt_image image { pixels.data(), width, height, channels };
+                utxt_render_batch(image, font, jobs.data(), jobs.size(),
+                    { .num_threads = num_threads, .tile_size = tile_size });
+                CHECK(pixels == expected);
+            }
+        }
+    }
+
+    utxt_font_free(font);
+}
+
+// Backing allocator for arenas that counts its calls and how much is allocated.
+struct CountingAlloc {
+    size_t num_calls = 0;
+    size_t num_bytes = 0;
+};
+
+static void* counting_realloc(void* ptr, size_t old_size, size_t new_size, void* ctx)
+{
+    auto& counter = *(CountingAlloc*)ctx;
+    counter.num_calls++;
+    counter.num_bytes = counter.num_bytes - old_size + new_size;
+    if (!new_size) {
+        std::free(ptr);
+        return nullptr;
+    }
+    return std::realloc(ptr, new_size);
+}
+
+static uint8_t* arena_allocate(utxt_alloc alloc, size_t size)
+{
+    return (uint8_t*)alloc.realloc(nullptr, 0, size, alloc.ctx);
+}
+
+static bool is_filled(const uint8_t* data, size_t size, uint8_t value)
+{
+    return std::all_of(data, data + size, [value](uint8_t v) { return v == value; });
+}
+
+static void test_arena()
+{
+    CountingAlloc backing;
+    utxt_arena* arena = utxt_arena_create({ counting_realloc, &backing }, 1024);
+    const auto alloc = utxt_arena_get_alloc(arena);
+
+    // Everything allocated after a mark is released by resetting to it
+    const auto a = arena_allocate(alloc, 100);
+    std::memset(a, 1, 100);
+    const auto mark = utxt_arena_mark(arena);
+    CHECK(mark >= 100);
+    const auto b = arena_allocate(alloc, 200);
+    CHECK(b >= a + 100);
+    utxt_arena_reset(arena, mark);
+    CHECK(utxt_arena_mark(arena) == mark);
+    CHECK(arena_allocate(alloc, 200) == b);
+    CHECK(is_filled(a, 100, 1));
+
+    // The last allocation is resized in place, also after the ones after it were freed
+    const auto c = arena_allocate(alloc, 50);
+    CHECK(alloc.realloc(c, 50, 300, alloc.ctx) == c);
+    CHECK(alloc.realloc(c, 300, 20, alloc.ctx) == c);
+    const auto d = arena_allocate(alloc, 16);
+    CHECK(!alloc.realloc(d, 16, 0, alloc.ctx));
+    CHECK(alloc.realloc(c, 20, 400, alloc.ctx) == c);
+    // Other allocations are copied
+    std::memset(c, 2, 400);
+    arena_allocate(alloc, 16);
+    const auto c2 = (uint8_t*)alloc.realloc(c, 400, 500, alloc.ctx);
+    CHECK(c2 != c);
+    CHECK(is_filled(c2, 400, 2));
+    // Freeing the last allocation makes its memory available again
+    CHECK(!alloc.realloc(c2, 500, 0, alloc.ctx));
+    CHECK(arena_allocate(alloc, 10) == c2);
+
+    // Allocations bigger than a block get their own block, which grows with them instead of
+    // leaving the old copy behind
+    const auto capacity = utxt_arena_get_capacity(arena);
+    auto big = arena_allocate(alloc, 5000);
+    std::memset(big, 3, 5000);
+    CHECK(utxt_arena_get_capacity(arena) >= capacity + 5000);
+    big = (uint8_t*)alloc.realloc(big, 5000, 20000, alloc.ctx);
+    CHECK(is_filled(big, 5000, 3));
+    CHECK(utxt_arena_get_capacity(arena) >= capacity + 20000);
+    CHECK(utxt_arena_get_capacity(arena) < capacity + 20000 + 1024);
+
+    // Once the blocks exist, the same allocations don't need the backing allocator anymore
+    const size_t sizes[] = { 100, 700, 5000, 300, 30000, 50, 900, 2000 };
+    size_t num_calls = 0;
+    for (size_t round = 0; round < 3; ++round) {
+        utxt_arena_reset(arena, 0);
+        CHECK(utxt_arena_mark(arena) == 0);
+        for (const auto size : sizes) {
+            std::memset(arena_allocate(alloc, size), 4, size);
+        }
+        if (round > 0) {
+            CHECK(backing.num_calls == num_calls);
+        }
+        num_calls = backing.num_calls;
+    }
+    CHECK(backing.num_bytes >= utxt_arena_get_capacity(arena));
+
+    utxt_arena_free(arena);
+    CHECK(backing.num_bytes == 0);
+}
+
+// Random LIFO-ish use of an arena, checking that no allocation overwrites another one.
+static void test_arena_fuzz()
+{
+    CountingAlloc backing;
+    utxt_arena* arena = utxt_arena_create({ counting_realloc, &backing }, 4096);
+    const auto alloc = utxt_arena_get_alloc(arena);
+
+    struct Allocation {
+        uint8_t* data;
+        size_t size;
+        uint8_t value;
+        size_t generation; // allocations with a generation before the mark must not be resized
+    };
+    std::vector<Allocation> allocations;
+    size_t generation = 0;
+    size_t mark = 0;
+    size_t mark_generation = 0;
+    uint32_t rng = 777;
+
+    const auto random_size = [&]() -> size_t {
+        return next_random(rng) % 8 == 0 ? 1 + next_random(rng) % 10000
+                                         : 1 + next_random(rng) % 300;
+    };
+    const auto fill = [&](Allocation& a) {
+        a.value = (uint8_t)next_random(rng);
+        std::memset(a.data, a.value, a.size);
+    };
+
+    for (size_t i = 0; i < 20000; ++i) {
+        const auto op = next_random(rng) % 10;
+        if (op < 4 || allocations.empty()) {
+            Allocation a { nullptr, random_size(), 0, generation++ };
+            a.data = arena_allocate(alloc, a.size);
+            CHECK((uintptr_t)a.data % alignof(std::max_align_t) == 0);
+            fill(a);
+            allocations.push_back(a);
+        } else if (op < 7) {
+            // Free the last allocation (in place) or another one (does nothing)
+            const auto idx
+                = op == 6 ? next_random(rng) % allocations.size() : allocations.size() - 1;
+            if (allocations[idx].generation < mark_generation) {
+                continue;
+            }
+            alloc.realloc(allocations[idx].data, allocations[idx].size, 0, alloc.ctx);
+            allocations.erase(allocations.begin() + (ptrdiff_t)idx);
+        } else if (op < 9) {
+            const auto idx
+                = op == 8 ? next_random(rng) % allocations.size() : allocations.size() - 1;
+            auto& a = allocations[idx];
+            if (a.generation < mark_generation) {
+                continue;
+            }
+            const auto new_size = random_size();
+            a.data = (uint8_t*)alloc.realloc(a.data, a.size, new_size, alloc.ctx);
+            CHECK(is_filled(a.data, std::min(a.size, new_size), a.value));
+            a.size = new_size;
+            fill(a);
+        } else if (next_random(rng) % 2 || !mark_generation) {
+            mark = utxt_arena_mark(arena);
+            mark_generation = generation;
+        } else {
+            utxt_arena_reset(arena, mark);
+            std::erase_if(allocations, [&](const Allocation& a) {
+                return a.generation >= mark_generation;
+            });
+            mark_generation = 0;
+        }
+
+        if (i % 64 == 0) {
+            for (const auto& a : allocations) {
+                CHECK(is_filled(a.data, a.size, a.value));
+            }
+        }
+    }
+
+    utxt_arena_free(arena);
+    CHECK(backing.num_bytes == 0);
+}
+
+// Fonts and layouts allocated from an arena must be the same as with the default allocator, frame
+// after frame, without the arena growing after the first frame.
+static void test_arena_layout(const std::vector<uint8_t>& ttf)
+{
+    const utxt_load_ttf_params params { .size = 20, .atlas_size = 512 };
+    utxt_font* font = utxt_font_load_ttf_buffer({}, ttf.data(), ttf.size(), params);
+    CHECK(font);
+    if (!font) {
+        return;
+    }
+
+    CountingAlloc backing;
+    utxt_arena* arena = utxt_arena_create({ counting_realloc, &backing }, 0);
+    const auto alloc = utxt_arena_get_alloc(arena);
+    utxt_font* arena_font = utxt_font_load_ttf_buffer(alloc, ttf.data(), ttf.size(), params);
+    CHECK(arena_font);
+    if (!arena_font) {
+        utxt_arena_free(arena);
+        utxt_font_free(font);
+        return;
+    }
+
+    size_t num_glyphs = 0, num_arena_glyphs = 0;
+    const auto glyphs = utxt_get_glyphs(font, &num_glyphs);
+    const auto arena_glyphs = utxt_get_glyphs(arena_font, &num_arena_glyphs);
+    CHECK(std::equal(glyphs, glyphs + num_glyphs, arena_glyphs, arena_glyphs + num_arena_glyphs));
+    size_t num_pairs = 0, num_arena_pairs = 0;
+    const auto pairs = utxt_get_kerning_pairs(font, &num_pairs);
+    const auto arena_pairs = utxt_get_kerning_pairs(arena_font, &num_arena_pairs);
+    CHECK(std::equal(pairs, pairs + num_pairs, arena_pairs, arena_pairs + num_arena_pairs,
+        [](const utxt_kerning_pair& a, const utxt_kerning_pair& b) {
+            return a.first_glyph == b.first_glyph && a.second_glyph == b.second_glyph
+                && a.amount == b.amount;
+        }));
+    uint32_t width, height, channels;
+    const auto atlas = utxt_get_atlas(font, &width, &height, &channels);
+    const auto arena_atlas = utxt_get_atlas(arena_font, &width, &height, &channels);
+    CHECK(std::memcmp(atlas, arena_atlas, (size_t)width * height * channels) == 0);
+
+    uint32_t rng = 99;
+    std::vector<char> texts[3];
+    for (size_t i = 0; i < std::size(texts); ++i) {
+        texts[i] = random_text(rng, 300 + 50 * i);
+    }
+
+    const auto mark = utxt_arena_mark(arena);
+    size_t capacity = 0;
+    for (size_t frame = 0; frame < 10; ++frame) {
+        const auto& text = texts[frame % std::size(texts)];
+        const utxt_string str { text.data(), text.size() };
+        const auto wrap_width = 100.0f + 100.0f * (float)(frame % std::size(texts));
+
+        // Starts small, so it grows while the text is added
+        utxt_layout* layout = utxt_layout_create(alloc, 16);
+        utxt_layout_set_growth(layout, UTXT_LAYOUT_GROWTH_GROW);
+        utxt_layout_reset(layout, wrap_width, UTXT_TEXT_ALIGN_RIGHT);
+        utxt_layout_add_text(layout, arena_font, str);
+        utxt_layout_compute(layout);
+        CHECK(get_layout_contents(layout, arena_font)
+            == get_reference_layout(font, str, wrap_width, UTXT_TEXT_ALIGN_RIGHT));
+        utxt_layout_free(layout);
+
+        utxt_arena_reset(arena, mark);
+        if (frame == std::size(texts) - 1) {
+            capacity = utxt_arena_get_capacity(arena);
+        } else if (frame >= std::size(texts)) {
+            CHECK(utxt_arena_get_capacity(arena) == capacity);
+        }
+    }
+
+    utxt_arena_free(arena);
+    utxt_font_free(font);
+}
+
+// utxt_layout_add_text must place every glyph like the model, also for words that are longer than
+// a line or than any fixed buffer (more than 128 glyphs).
+static void test_layout_words(const utxt_font* font)
+{
+    uint32_t rng = 1;
+    for (size_t i = 0; i < 50; ++i) {
+        const auto text = random_text(rng, 1 + next_random(rng) % 300);
+        const utxt_string str { text.data(), text.size() };
+        const float wrap_widths[] = { 0.0f, 1.0f + (float)(next_random(rng) % 800), 1e9f };
+        for (const auto wrap_width : wrap_widths) {
+            const auto expected = get_model_layout(font, str, wrap_width);
+
+            // Exactly enough glyphs, and growing from nothing
+            utxt_layout* fixed = utxt_layout_create({}, (uint32_t)expected.glyphs.size());
+            utxt_layout* growing = utxt_layout_create({}, 0);
+            utxt_layout_set_growth(growing, UTXT_LAYOUT_GROWTH_GROW);
+            for (const auto layout : { fixed, growing }) {
+                utxt_layout_reset(layout, wrap_width, UTXT_TEXT_ALIGN_LEFT);
+                CHECK(utxt_layout_add_text(layout, font, str) == expected.glyphs.size());
+                utxt_layout_compute(layout);
+                const auto contents = get_layout_contents(layout, font);
+                CHECK(contents.glyphs == expected.glyphs);
+                CHECK(contents.text_offsets == expected.text_offsets);
+                utxt_layout_free(layout);
+            }
+        }
+    }
+}
+
+// Adds text in pieces that end after whitespace (so no word or kerning pair is split), computing
+// the layout after every piece like a log that is appended to.
+static void add_text_in_pieces(
+    utxt_layout* layout, const utxt_font* font, utxt_string text, uint32_t& rng)
+{
+    size_t start = 0;
+    for (size_t i = 0; i < text.len; ++i) {
+        const auto c = text.data[i];
+        if ((c == ' ' || c == '\n') && next_random(rng) % 8 == 0) {
+            utxt_layout_add_text(layout, font, { text.data + start, i + 1 - start });
+            utxt_layout_compute(layout);
+            start = i + 1;
+        }
+    }
+    utxt_layout_add_text(layout, font, { text.data + start, text.len - start });
+    utxt_layout_compute(layout);
+}
+
+// Appending and editing with utxt_layout_rewind must give the same layout as laying out the whole
+// text again, and only the glyphs reported by utxt_layout_take_changes may change.
+static void test_layout_rewind(const utxt_font* font)
+{
+    uint32_t rng = 2;
+    for (size_t i = 0; i < 30; ++i) {
+        auto text = random_text(rng, 50 + next_random(rng) % 200);
+        const auto wrap_width = 50.0f + (float)(next_random(rng) % 500);
+        const auto align = (utxt_text_align)(i % 3);
+
+        utxt_layout* layout = utxt_layout_create({}, 0);
+        utxt_layout_set_growth(layout, UTXT_LAYOUT_GROWTH_GROW);
+        utxt_layout_reset(layout, wrap_width, align);
+        add_text_in_pieces(layout, font, { text.data(), text.size() }, rng);
+        CHECK(get_layout_contents(layout, font)
+            == get_reference_layout(font, { text.data(), text.size() }, wrap_width, align));
+        utxt_layout_take_changes(layout);
+
+        for (size_t edit = 0; edit < 10; ++edit) {
+            const auto before = get_layout_contents(layout, font);
+
+            // Replace a random range (at code point boundaries) with random words
+            const auto random_boundary = [&](size_t min) {
+                auto offset = min + next_random(rng) % (text.size() + 1 - min);
+                while (offset < text.size() && (text[offset] & 0xC0) == 0x80) {
+                    offset++;
+                }
+                return offset;
+            };
+            const auto first = random_boundary(0);
+            const auto end = next_random(rng) % 2 ? first : random_boundary(first);
+            const auto insert = random_text(rng, next_random(rng) % 4);
+            text.erase(text.begin() + (ptrdiff_t)first, text.begin() + (ptrdiff_t)end);
+            text.insert(text.begin() + (ptrdiff_t)first, insert.begin(), insert.end());
+
+            const auto offset = utxt_layout_rewind(layout, first);
+            CHECK(offset <= first);
+            utxt_layout_add_text(layout, font, { text.data() + offset, text.size() - offset });
+            utxt_layout_compute(layout);
+            const auto after = get_layout_contents(layout, font);
+            CHECK(after == get_reference_layout(font, { text.data(), text.size() }, wrap_width,
+                align));
+
+            const auto changes = utxt_layout_take_changes(layout);
+            CHECK(changes.first_glyph + changes.num_glyphs == after.glyphs.size());
+            CHECK(changes.first_glyph <= before.glyphs.size());
+            CHECK(std::equal(after.glyphs.begin(), after.glyphs.begin() + changes.first_glyph,
+                before.glyphs.begin()));
+        }
+        utxt_layout_free(layout);
+    }
+}
+
+// A virtual layout must have the lines of the whole text laid out at once, also where the text is
+// split into chunks, and materializing any range of lines must give the same glyphs and lines,
+// relative to the first line.
+static void test_virtual_layout(const utxt_font* font)
+{
+    uint32_t rng = 3;
+    const auto big_text = random_text(rng, 15000);
+    auto single_line = big_text;
+    std::replace(single_line.begin(), single_line.end(), '\n', ' ');
+    const auto small_text = random_text(rng, 100);
+
+    struct Case {
+        const std::vector<char>& text;
+        float wrap_width;
+        utxt_text_align align;
+    };
+    const Case cases[] = {
+        { big_text, 300.0f, UTXT_TEXT_ALIGN_CENTER },
+        { single_line, 1e9f, UTXT_TEXT_ALIGN_LEFT },
+        { small_text, 0.0f, UTXT_TEXT_ALIGN_RIGHT },
+    };
+    const auto ascent = utxt_get_font_metrics(font)->ascent;
+    size_t num_font_glyphs = 0;
+    const auto font_glyphs = utxt_get_glyphs(font, &num_font_glyphs);
+
+    for (const auto& c : cases) {
+        const utxt_string text { c.text.data(), c.text.size() };
+        const auto expected = get_reference_layout(font, text, c.wrap_width, c.align);
+        utxt_virtual_layout* vlayout = utxt_virtual_layout_create({});
+        utxt_virtual_layout_set_text(vlayout, font, text, c.wrap_width, c.align);
+
+        const auto num_lines = utxt_virtual_layout_get_num_lines(vlayout);
+        CHECK(num_lines == expected.lines.size());
+        if (num_lines != expected.lines.size()) {
+            utxt_virtual_layout_free(vlayout);
+            continue;
+        }
+        double y = 0.0;
+        for (size_t l = 0; l < num_lines; ++l) {
+            const auto& line = expected.lines[l];
+            CHECK(utxt_virtual_layout_get_line_text_offset(vlayout, l) == line.text_offset);
+            CHECK(utxt_virtual_layout_get_line_y(vlayout, l) == y);
+            CHECK(utxt_virtual_layout_find_line(vlayout, y - ascent + 0.5) == l);
+            CHECK(utxt_virtual_layout_find_text_offset(vlayout, line.text_offset) == l);
+            y += line.height;
+        }
+        CHECK(utxt_virtual_layout_get_height(vlayout) == y);
+
+        utxt_layout* layout = utxt_layout_create({}, 0);
+        utxt_layout_set_growth(layout, UTXT_LAYOUT_GROWTH_GROW);
+        for (size_t i = 0; i < 20; ++i) {
+            const auto first_line = next_random(rng) % num_lines;
+            const auto count = i == 0 ? num_lines : 1 + next_random(rng) % 30;
+            const auto num_materialized
+                = utxt_virtual_layout_materialize(vlayout, layout, first_line, count);
+            CHECK(num_materialized == std::min(count, num_lines - first_line));
+            const auto contents = get_layout_contents(layout, font);
+            CHECK(contents.lines.size() == num_materialized);
+            if (contents.lines.size() != num_materialized) {
+                continue;
+            }
+
+            // Everything is relative to the first line, y is accumulated from there like the
+            // layout does it.
+            const auto& first = expected.lines[first_line];
+            float line_y = 0.0f;
+            size_t g = 0;
+            for (size_t l = 0; l < num_materialized; ++l) {
+                const auto& line = contents.lines[l];
+                const auto& expected_line = expected.lines[first_line + l];
+                CHECK(line.first_glyph == expected_line.first_glyph - first.first_glyph);
+                CHECK(line.num_glyphs == expected_line.num_glyphs);
+                CHECK(line.text_offset == expected_line.text_offset - first.text_offset);
+                CHECK(line.x == expected_line.x);
+                CHECK(line.y == line_y);
+                CHECK(line.width == expected_line.width);
+                CHECK(line.height == expected_line.height);
+                CHECK(line.ascent == expected_line.ascent);
+                for (; g < line.first_glyph + line.num_glyphs && g < contents.glyphs.size(); ++g) {
+                    const auto& lg = contents.glyphs[g];
+                    const auto e = first.first_glyph + g;
+                    CHECK(lg.glyph == expected.glyphs[e].glyph);
+                    CHECK(lg.x == expected.glyphs[e].x);
+                    CHECK(lg.y == font_glyphs[lg.glyph].bearing_y + line_y);
+                    CHECK(contents.text_offsets[g] == expected.text_offsets[e] - first.text_offset);
+                }
+                line_y += expected_line.height;
+            }
+            CHECK(g == contents.glyphs.size());
+        }
+        utxt_layout_free(layout);
+        utxt_virtual_layout_free(vlayout);
+    }
+}
+
+// utxt_layout_add_text_parallel must give the same layout as utxt_layout_add_text, also between
+// text that is added before and after it.
+static void test_layout_parallel(const utxt_font* font)
+{
+    uint32_t rng = 4;
+    for (size_t i = 0; i < 3; ++i) {
+        const auto head = random_text(rng, next_random(rng) % 20);
+        const auto body = random_text(rng, 6000 + next_random(rng) % 6000);
+        const auto tail = random_text(rng, next_random(rng) % 20);
+        std::vector<char> text = head;
+        text.insert(text.end(), body.begin(), body.end());
+        text.insert(text.end(), tail.begin(), tail.end());
+        const auto wrap_width = 100.0f + (float)(next_random(rng) % 500);
+        const auto align = (utxt_text_align)(i % 3);
+        const auto expected
+            = get_reference_layout(font, { text.data(), text.size() }, wrap_width, align);
+
+        for (const uint32_t num_threads : { 1u, 2u, 3u, 8u }) {
+            utxt_layout* layout = utxt_layout_create({}, 0);
+            utxt_layout_set_growth(layout, UTXT_LAYOUT_GROWTH_GROW);
+            utxt_layout_reset(layout, wrap_width, align);
+            utxt_layout_add_text(layout, font, { head.data(), head.size() });
+            utxt_layout_compute(layout);
+            const auto num_added = utxt_layout_add_text_parallel(
+                layout, font, { body.data(), body.size() }, { .num_threads = num_threads });
+            utxt_layout_add_text(layout, font, { tail.data(), tail.size() });
+            utxt_layout_compute(layout);
+
+            const auto contents = get_layout_contents(layout, font);
+            CHECK(contents == expected);
+            CHECK(num_added
+                == get_reference_layout(font, { body.data(), body.size() }, 0.0f, align)
+                       .glyphs.size());
+            utxt_layout_free(layout);
+        }
+    }
+}
+
+// utxt_measure_text must give the size of the lines of utxt_layout_add_text exactly.
+static void test_measure_text(const utxt_font* font)
+{
+    uint32_t rng = 5;
+    for (size_t i = 0; i < 100; ++i) {
+        const auto text = random_text(rng, next_random(rng) % 200);
+        const utxt_string str { text.data(), text.size() };
+        const float wrap_widths[] = { 0.0f, 1.0f + (float)(next_random(rng) % 800), 1e9f };
+        for (const auto wrap_width : wrap_widths) {
+            const auto expected = get_reference_layout(font, str, wrap_width, UTXT_TEXT_ALIGN_LEFT);
+            float width = 0.0f;
+            for (const auto& line : expected.lines) {
+                width = std::max(width, line.width);
+            }
+            const auto& last = expected.lines.back();
+
+            const auto size = utxt_measure_text(font, str, wrap_width);
+            CHECK(size.num_lines == expected.lines.size());
+            CHECK(size.width == width);
+            CHECK(size.height == last.y + last.height);
+        }
+    }
+}
+
+// A word cache must not change the layout, also when it is shared by fonts that lay out the same
+// words differently, when entries collide and when cached words don't fit into the layout.
+// utxt_get_text_widths must give the same widths as utxt_get_text_width and only start threads
+// when asked to. The only allocation parallel_for makes is for the threads.
+static void test_text_widths(const utxt_font* font)
+{
+    uint32_t rng = 12;
+    const auto text = random_text(rng, 20000);
+    std::vector<utxt_string> texts;
+    size_t start = 0;
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (text[i] == ' ' || text[i] == '\n') {
+            texts.push_back({ text.data() + start, i - start });
+            start = i + 1;
+        }
+    }
+
+    size_t num_calls[3];
+    for (const uint32_t num_threads : { 0u, 1u, 4u }) {
+        CountingAlloc counter;
+        std::vector<float> widths(texts.size());
+        utxt_get_text_widths(font, texts.data(), widths.data(), texts.size(),
+            { { counting_realloc, &counter }, num_threads });
+        for (size_t i = 0; i < texts.size(); ++i) {
+            CHECK(widths[i] == utxt_get_text_width(font, texts[i]));
+        }
+        CHECK(counter.num_bytes == 0);
+        num_calls[std::min<size_t>(num_threads, 2)] = counter.num_calls;
+    }
+    CHECK(num_calls[0] == num_calls[1]);
+    CHECK(num_calls[2] == num_calls[1] + 2);
+}
+
+// Text that fits is drawn like utxt_draw_text. Otherwise the longest prefix that leaves room for
+// the ellipsis is drawn, followed by the ellipsis, or only the ellipsis if nothing else fits.
+static void test_truncate_text(const utxt_font* font)
+{
+    const utxt_string text = UTXT_LITERAL("AVAST, ye Wolf. To you.");
+    const utxt_string ellipsis = UTXT_LITERAL("...");
+    const float x = 5.0f, y = 30.0f;
+    utxt_quad drawn[32], ellipsis_quads[4], quads[32];
+    const auto num_drawn = utxt_draw_text(drawn, std::size(drawn), font, text, x, y);
+    const auto num_ellipsis
+        = utxt_draw_text(ellipsis_quads, std::size(ellipsis_quads), font, ellipsis, x, y);
+    CHECK(num_drawn == text.len);
+    CHECK(num_ellipsis == ellipsis.len);
+    const auto text_width = utxt_get_text_width(font, text);
+    const auto ellipsis_width = utxt_get_text_width(font, ellipsis);
+
+    const auto truncate = [&](utxt_quad* dst, size_t num_quads, float max_width) {
+        return utxt_truncate_text(dst, num_quads, font, text, x, y, max_width, ellipsis);
+    };
+
+    // Fits
+    CHECK(truncate(quads, std::size(quads), text_width) == num_drawn);
+    CHECK(std::equal(quads, quads + num_drawn, drawn));
+    CHECK(truncate(quads, std::size(quads), 1000.0f) == num_drawn);
+    CHECK(std::equal(quads, quads + num_drawn, drawn));
+
+    // No room for anything but the ellipsis, which is drawn even if it doesn't fit either
+    for (const auto max_width : { 0.0f, ellipsis_width / 2, ellipsis_width }) {
+        CHECK(truncate(quads, std::size(quads), max_width) == num_ellipsis);
+        CHECK(std::equal(quads, quads + num_ellipsis, ellipsis_quads));
+    }
+
+    size_t prev_prefix = 0;
+    for (auto max_width = ellipsis_width + 1.0f; max_width < text_width; max_width += 1.0f) {
+        const auto n = truncate(quads, std::size(quads), max_width);
+        CHECK(n >= num_ellipsis && n < num_drawn + num_ellipsis);
+        if (n < num_ellipsis) {
+            continue;
+        }
+        const auto prefix = n - num_ellipsis;
+        CHECK(std::equal(quads, quads + prefix, drawn));
+        // Every glyph is one byte of the text, and the ellipsis doesn't follow whitespace
+        CHECK(prefix == 0 || text.data[prefix - 1] != ' ');
+        CHECK(prefix >= prev_prefix);
+        prev_prefix = prefix;
+
+        const auto shift = quads[prefix].x - ellipsis_quads[0].x;
+        for (size_t i = 0; i < num_ellipsis; ++i) {
+            const auto& q = quads[prefix + i];
+            const auto& e = ellipsis_quads[i];
+            CHECK(std::fabs(q.x - e.x - shift) < 1e-3f);
+            CHECK(q.y == e.y && q.w == e.w && q.h == e.h && q.u0 == e.u0 && q.v1 == e.v1);
+        }
+        CHECK(quads[n - 1].x + quads[n - 1].w - quads[0].x <= max_width + 1e-3f);
+
+        // Buffer too small, or no buffer to count the quads
+        CHECK(truncate(quads, n - 1, max_width) == n);
+        CHECK(truncate(nullptr, 0, max_width) == n);
+    }
+    CHECK(prev_prefix > 0);
+
+    CHECK(utxt_truncate_text(quads, std::size(quads), font, {}, x, y, 0.0f, ellipsis) == 0);
+}
+
+// The line table must describe the glyphs, and hit testing and glyph rects must agree with a linear
+// search over the lines and glyphs.
+static void test_layout_hit_test(const utxt_font* font)
+{
+    uint32_t rng = 13;
+    for (size_t i = 0; i < 30; ++i) {
+        const auto text = random_text(rng, 1 + next_random(rng) % 200);
+        const auto wrap_width = 50.0f + (float)(next_random(rng) % 500);
+        const auto align = (utxt_text_align)(i % 3);
+        utxt_layout* layout = utxt_layout_create({}, 0);
+        utxt_layout_set_growth(layout, UTXT_LAYOUT_GROWTH_GROW);
+        utxt_layout_reset(layout, wrap_width, align);
+        utxt_layout_add_text(layout, font, { text.data(), text.size() });
+        utxt_layout_compute(layout);
+
+        size_t num_glyphs = 0, num_lines = 0;
+        const auto glyphs = utxt_layout_get_glyphs(layout, &num_glyphs);
+        const auto text_offsets = utxt_layout_get_glyph_text_offsets(layout, &num_glyphs);
+        const auto lines = utxt_layout_get_lines(layout, &num_lines);
+        CHECK(num_lines > 0);
+        const auto pen_x = [&](size_t g) { return glyphs[g].x - glyphs[g].glyph->bearing_x; };
+
+        size_t next_glyph = 0;
+        for (size_t l = 0; l < num_lines; ++l) {
+            const auto& line = lines[l];
+            CHECK(line.first_glyph == next_glyph);
+            next_glyph += line.num_glyphs;
+            if (l > 0) {
+                CHECK(line.y == lines[l - 1].y + lines[l - 1].height);
+                CHECK(line.text_offset >= lines[l - 1].text_offset);
+            }
+            if (line.num_glyphs) {
+                const auto last = line.first_glyph + line.num_glyphs - 1;
+                CHECK(line.text_offset <= text_offsets[line.first_glyph]);
+                CHECK(std::fabs(pen_x(line.first_glyph) - line.x) < 1e-3f);
+                CHECK(std::fabs(glyphs[last].x + glyphs[last].glyph->width - line.x - line.width)
+                    < 1e-3f);
+            }
+        }
+        CHECK(next_glyph == num_glyphs);
+
+        for (size_t g = 0; g < num_glyphs; ++g) {
+            const auto rect = utxt_layout_glyph_rect(layout, g);
+            const auto& line = *std::find_if(lines, lines + num_lines, [g](const auto& line) {
+                return g >= line.first_glyph && g < line.first_glyph + line.num_glyphs;
+            });
+            CHECK(rect.x == pen_x(g) && rect.w == glyphs[g].glyph->advance);
+            CHECK(rect.y == line.y - line.ascent && rect.h == line.height);
+        }
+
+        for (size_t p = 0; p < 200; ++p) {
+            const auto x = (float)(next_random(rng) % 1000) / 1000.0f * (wrap_width + 40) - 20;
+            const auto y = (float)(next_random(rng) % 1000) / 1000.0f
+                    * (lines[num_lines - 1].y + lines[num_lines - 1].height + 40)
+                - 40;
+            const auto hit = utxt_layout_hit_test(layout, x, y);
+
+            size_t line_idx = 0;
+            while (line_idx + 1 < num_lines
+                && lines[line_idx + 1].y - lines[line_idx + 1].ascent <= y) {
+                line_idx++;
+            }
+            CHECK(hit.line == line_idx);
+            const auto& line = lines[line_idx];
+            size_t caret = line.first_glyph, under = line.first_glyph;
+            for (auto g = line.first_glyph; g < line.first_glyph + line.num_glyphs; ++g) {
+                caret += pen_x(g) + glyphs[g].glyph->advance / 2.0f <= x;
+                under += pen_x(g) <= x;
+            }
+            CHECK(hit.caret == caret);
+            if (!line.num_glyphs) {
+                CHECK(hit.glyph == SIZE_MAX);
+                CHECK(hit.text_offset == line.text_offset);
+                continue;
+            }
+            CHECK(hit.glyph == std::max(under, line.first_glyph + 1) - 1);
+            const auto last = line.first_glyph + line.num_glyphs - 1;
+            size_t offset = text_offsets[last];
+            decode_utf8({ text.data(), text.size() }, offset);
+            CHECK(hit.text_offset == (caret <= last ? text_offsets[caret] : offset));
+        }
+        utxt_layout_free(layout);
+    }
+}
+
+// Appending to a quad buffer must give the same quads as utxt_draw_text for every text, and reusing
+// the buffer must not allocate again.
+static void test_quad_buffer(const utxt_font* font)
+{
+    uint32_t rng = 15;
+    CountingAlloc counter;
+    utxt_quad_buffer buffer {};
+    buffer.alloc = { counting_realloc, &counter };
+    std::vector<utxt_quad> expected;
+    for (size_t round = 0; round < 2; ++round) {
+        // The same texts again fit into the memory of the first round
+        rng = 15;
+        buffer.num_quads = 0;
+        expected.clear();
+        const auto num_calls = counter.num_calls;
+        for (size_t i = 0; i < 50; ++i) {
+            const auto text = random_text(rng, next_random(rng) % 20);
+            const utxt_string str { text.data(), text.size() };
+            const auto x = (float)(next_random(rng) % 500), y = (float)(next_random(rng) % 500);
+            std::vector<utxt_quad> quads(text.size());
+            quads.resize(utxt_draw_text(quads.data(), quads.size(), font, str, x, y));
+            CHECK(utxt_draw_text_append(&buffer, font, str, x, y) == quads.size());
+            expected.insert(expected.end(), quads.begin(), quads.end());
+        }
+        CHECK(buffer.num_quads == expected.size());
+        CHECK(buffer.capacity >= buffer.num_quads);
+        CHECK(std::equal(buffer.quads, buffer.quads + buffer.num_quads, expected.begin(),
+            expected.end()));
+        CHECK(round == 0 ? counter.num_calls > num_calls : counter.num_calls == num_calls);
+    }
+    utxt_quad_buffer_free(&buffer);
+    CHECK(!buffer.quads && buffer.num_quads == 0 && buffer.capacity == 0);
+    CHECK(counter.num_bytes == 0);
+
+    // Zero-initialized without an allocator
+    utxt_quad_buffer default_buffer {};
+    CHECK(utxt_draw_text_append(&default_buffer, font, UTXT_LITERAL("Quads"), 0, 0) == 5);
+    CHECK(utxt_draw_text_append(&default_buffer, font, {}, 0, 0) == 0);
+    CHECK(default_buffer.num_quads == 5);
+    utxt_quad_buffer_free(&default_buffer);
+}
+
+// Instances looked up in the glyph table must give the same quads as utxt_draw_text.
+static void test_glyph_instances(const utxt_font* font)
+{
+    size_t num_glyphs = 0;
+    const auto glyphs = utxt_get_glyphs(font, &num_glyphs);
+    CHECK(utxt_get_glyph_table(font, nullptr, 0) == num_glyphs);
+    // Nothing is written if the table is too small
+    std::vector<utxt_glyph_table_entry> table(num_glyphs, { -1.0f });
+    CHECK(utxt_get_glyph_table(font, table.data(), num_glyphs / 2) == num_glyphs / 2 + 1);
+    CHECK(utxt_get_glyph_table(font, table.data(), num_glyphs - 1) == num_glyphs);
+    CHECK(std::all_of(table.begin(), table.end(), [](const auto& e) { return e.width == -1; }));
+    CHECK(utxt_get_glyph_table(font, table.data(), num_glyphs) == num_glyphs);
+    for (size_t i = 0; i < num_glyphs; ++i) {
+        const auto& g = glyphs[i];
+        const auto& e = table[i];
+        CHECK(e.width == g.width && e.height == g.height && e.u0 == g.u0 && e.v0 == g.v0
+            && e.u1 == g.u1 && e.v1 == g.v1);
+    }
+
+    uint32_t rng = 16;
+    for (size_t i = 0; i < 50; ++i) {
+        const auto text = random_text(rng, next_random(rng) % 20);
+        const utxt_string str { text.data(), text.size() };
+        const auto x = (float)(next_random(rng) % 500), y = (float)(next_random(rng) % 500);
+        std::vector<utxt_quad> quads(text.size());
+        quads.resize(utxt_draw_text(quads.data(), quads.size(), font, str, x, y));
+
+        std::vector<utxt_glyph_instance> instances(text.size());
+        CHECK(utxt_draw_text_instances(nullptr, 0, font, str, x, y) == quads.size());
+        const auto n
+            = utxt_draw_text_instances(instances.data(), instances.size(), font, str, x, y);
+        CHECK(n == quads.size());
+        for (size_t q = 0; q < std::min(n, quads.size()); ++q) {
+            const auto& inst = instances[q];
+            CHECK(inst.glyph < num_glyphs);
+            if (inst.glyph >= num_glyphs) {
+                continue;
+            }
+            const auto& e = table[inst.glyph];
+            CHECK(quads[q]
+                == (utxt_quad { inst.x, inst.y, e.width, e.height, e.u0, e.v0, e.u1, e.v1 }));
+        }
+        if (n > 0) {
+            CHECK(utxt_draw_text_instances(instances.data(), n - 1, font, str, x, y) == n);
+        }
+    }
+}
+
+// Layouts from the cache must be the same as laying out the text, whether they were cached or
+// evicted, and the least recently used layouts must be evicted first.
+static void test_layout_cache(const utxt_font* font, const utxt_font* kerned_font)
+{
+    struct Key {
+        const utxt_font* font;
+        std::vector<char> text;
+        float wrap_width;
+        utxt_text_align align;
+    };
+    uint32_t rng = 17;
+    std::vector<Key> keys;
+    for (size_t i = 0; i < 30; ++i) {
+        keys.push_back({ i % 2 ? kerned_font : font, random_text(rng, next_random(rng) % 40),
+            (float)(next_random(rng) % 3 * 150), (utxt_text_align)(next_random(rng) % 3) });
+    }
+    // The same text with every other part of the key changed
+    keys.push_back({ kerned_font, keys[0].text, keys[0].wrap_width, keys[0].align });
+    keys.push_back({ font, keys[0].text, keys[0].wrap_width + 1.0f, keys[0].align });
+    keys.push_back(
+        { font, keys[0].text, keys[0].wrap_width, (utxt_text_align)((keys[0].align + 1) % 3) });
+
+    for (const size_t memory_budget : { (size_t)0, (size_t)4096, (size_t)1 << 20 }) {
+        CountingAlloc counter;
+        utxt_layout_cache* cache
+            = utxt_layout_cache_create({ counting_realloc, &counter }, memory_budget);
+        for (size_t i = 0; i < 300; ++i) {
+            const auto& key = keys[next_random(rng) % keys.size()];
+            const utxt_string str { key.text.data(), key.text.size() };
+            size_t count = 0;
+            const auto glyphs
+                = utxt_layout_cache_get(cache, key.font, str, key.wrap_width, key.align, &count);
+            LayoutContents contents;
+            for (size_t g = 0; g < count; ++g) {
+                contents.glyphs.push_back(get_layout_glyph(glyphs[g], key.font));
+            }
+            CHECK(contents.glyphs
+                == get_reference_layout(key.font, str, key.wrap_width, key.align).glyphs);
+
+            // Getting it again is a hit, if it fit into the budget
+            const auto num_calls = counter.num_calls;
+            size_t hit_count = 0;
+            const auto hit_glyphs = utxt_layout_cache_get(
+                cache, key.font, str, key.wrap_width, key.align, &hit_count);
+            CHECK(hit_count == count);
+            if (memory_budget == (size_t)1 << 20) {
+                CHECK(hit_glyphs == glyphs && counter.num_calls == num_calls);
+            }
+        }
+        utxt_layout_cache_clear(cache);
+        utxt_layout_cache_free(cache);
+        CHECK(counter.num_bytes == 0);
+    }
+
+    // Texts of the same length need entries of the same size, which we measure once the layout
+    // used for misses has grown.
+    const utxt_string texts[] = { UTXT_LITERAL("aaaa"), UTXT_LITERAL("bbbb"),
+        UTXT_LITERAL("cccc"), UTXT_LITERAL("dddd") };
+    CountingAlloc counter;
+    size_t count = 0;
+    utxt_layout_cache* cache = utxt_layout_cache_create({ counting_realloc, &counter }, 1 << 20);
+    utxt_layout_cache_get(cache, font, texts[0], 0.0f, UTXT_TEXT_ALIGN_LEFT, &count);
+    const auto used = counter.num_bytes;
+    utxt_layout_cache_get(cache, font, texts[1], 0.0f, UTXT_TEXT_ALIGN_LEFT, &count);
+    const auto entry_size = counter.num_bytes - used;
+    utxt_layout_cache_free(cache);
+
+    cache = utxt_layout_cache_create({ counting_realloc, &counter }, 3 * entry_size);
+    const auto is_hit = [&](size_t t) {
+        const auto num_calls = counter.num_calls;
+        utxt_layout_cache_get(cache, font, texts[t], 0.0f, UTXT_TEXT_ALIGN_LEFT, &count);
+        return counter.num_calls == num_calls;
+    };
+    CHECK(!is_hit(0) && !is_hit(1) && !is_hit(2));
+    CHECK(is_hit(0));
+    CHECK(!is_hit(3)); // evicts 1
+    CHECK(is_hit(2) && is_hit(0) && is_hit(3));
+    CHECK(!is_hit(1)); // evicts 2
+    CHECK(is_hit(0) && is_hit(3) && is_hit(1));
+    utxt_layout_cache_free(cache);
+    CHECK(counter.num_bytes == 0);
+}
+
+static bool fits_box(const utxt_font* font, utxt_string text, float box_width, float box_height,
+    float scale)
+{
+    const auto size = utxt_measure_text(font, text, box_width / scale);
+    return size.width * scale <= box_width && size.height * scale <= box_height;
+}
+
+// utxt_fit_text must return a scale at which the text fits (unless it is min_scale), and for a
+// single word, whose size is proportional to the scale, the largest one within 0.1%.
+static void test_fit_text(const utxt_font* font)
+{
+    const utxt_string word = UTXT_LITERAL("Fitting");
+    const auto size = utxt_measure_text(font, word, 0.0f);
+    CHECK(size.num_lines == 1);
+    for (const auto box_height : { size.height * 0.7f, size.height * 1.3f, size.height * 3.0f }) {
+        for (const auto box_width : { size.width * 0.5f, size.width * 1.1f, size.width * 2.5f }) {
+            const auto scale = utxt_fit_text(font, word, box_width, box_height, 0.25f, 4.0f);
+            const auto expected = std::min(box_width / size.width, box_height / size.height);
+            CHECK(fits_box(font, word, box_width, box_height, scale));
+            CHECK(scale <= expected && scale >= expected / 1.001f);
+        }
+    }
+    // Clamped to the range
+    CHECK(utxt_fit_text(font, word, size.width * 10, size.height * 10, 0.5f, 2.0f) == 2.0f);
+    CHECK(utxt_fit_text(font, word, size.width / 10, size.height, 0.5f, 2.0f) == 0.5f);
+    CHECK(utxt_fit_text(font, word, size.width / 10, size.height, 1.5f, 1.5f) == 1.5f);
+
+    uint32_t rng = 18;
+    for (size_t i = 0; i < 30; ++i) {
+        const auto text = random_text(rng, 1 + next_random(rng) % 100);
+        const utxt_string str { text.data(), text.size() };
+        const auto box_width = 100.0f + (float)(next_random(rng) % 400);
+        const auto box_height = 50.0f + (float)(next_random(rng) % 400);
+        const auto scale = utxt_fit_text(font, str, box_width, box_height, 0.1f, 3.0f);
+        CHECK(scale >= 0.1f && scale <= 3.0f);
+        CHECK(scale == 0.1f || fits_box(font, str, box_width, box_height, scale));
+        // Wrapping can make fitting non-monotonic, but not for these texts near the result
+        CHECK(scale == 3.0f || !fits_box(font, str, box_width, box_height, scale * 1.002f));
+    }
+}
+
+// Glyph positions must match the quads of utxt_draw_text, and the advances and widths of ranges of
+// them must match drawing and measuring the corresponding substrings on their own.
+static void test_glyph_positions(const utxt_font* font)
+{
+    uint32_t rng = 19;
+    for (size_t i = 0; i < 30; ++i) {
+        auto text = random_text(rng, 1 + next_random(rng) % 30);
+        std::replace(text.begin(), text.end(), '\n', ' ');
+        const utxt_string str { text.data(), text.size() };
+
+        std::vector<utxt_quad> quads(text.size());
+        quads.resize(utxt_draw_text(quads.data(), quads.size(), font, str, 0.0f, 0.0f));
+        const auto count = utxt_get_glyph_positions(nullptr, 0, font, str);
+        CHECK(count == quads.size());
+        std::vector<utxt_glyph_position> positions(text.size());
+        if (count > 0) {
+            CHECK(utxt_get_glyph_positions(positions.data(), count - 1, font, str) == count);
+        }
+        CHECK(utxt_get_glyph_positions(positions.data(), positions.size(), font, str) == count);
+        for (size_t g = 0; g < count; ++g) {
+            const auto& p = positions[g];
+            CHECK(p.x0 == quads[g].x && p.x1 == quads[g].x + quads[g].w);
+            CHECK(p.x0 == p.x + p.glyph->bearing_x);
+            CHECK(p.text_offset < text.size());
+            CHECK(g == 0 || p.text_offset > positions[g - 1].text_offset);
+        }
+
+        for (size_t r = 0; r < 20; ++r) {
+            const auto first = next_random(rng) % (count + 1);
+            const auto end = first + next_random(rng) % (count + 1 - first);
+            const auto begin_offset = first < count ? positions[first].text_offset : text.size();
+            const auto end_offset = end < count ? positions[end].text_offset : text.size();
+            const utxt_string substr { text.data() + begin_offset, end_offset - begin_offset };
+
+            std::vector<utxt_quad> sub_quads(substr.len);
+            utxt_draw_text_state state { substr, 0.0f, 0 };
+            CHECK(utxt_draw_text_batch(sub_quads.data(), sub_quads.size(), font, &state, 0.0f)
+                == end - first);
+            CHECK(std::fabs(utxt_glyph_positions_get_advance(positions.data(), first, end)
+                      - state.cursor_x)
+                < 1e-2f);
+            CHECK(std::fabs(utxt_glyph_positions_get_width(positions.data(), first, end)
+                      - utxt_get_text_width(font, substr))
+                < 1e-2f);
+        }
+
+        for (size_t p = 0; p < 20; ++p) {
+            const auto x = (float)(next_random(rng) % 1000) / 1000.0f
+                    * (count ? positions[count - 1].x1 + 20 : 20)
+                - 10;
+            size_t caret = 0;
+            while (caret < count && positions[caret].x + positions[caret].glyph->advance / 2 <= x) {
+                caret++;
+            }
+            CHECK(utxt_glyph_positions_find(positions.data(), count, x) == caret);
+        }
+    }
+}
+
+// utxt_layout_add_glyphs must wrap every glyph on its own and drop glyphs like add_text does.
+static void test_layout_glyphs(const utxt_font* font)
+{
+    uint32_t rng = 20;
+    for (size_t i = 0; i < 30; ++i) {
+        const auto text = random_text(rng, 1 + next_random(rng) % 100);
+        const utxt_string str { text.data(), text.size() };
+        // Also narrower than every glyph
+        const auto wrap_width = i % 5 == 0 ? 1.0f : (float)(next_random(rng) % 400);
+        const auto expected = get_model_layout(font, str, wrap_width, true);
+
+        utxt_layout* layout = utxt_layout_create({}, 0);
+        utxt_layout_set_growth(layout, UTXT_LAYOUT_GROWTH_GROW);
+        utxt_layout_reset(layout, wrap_width, UTXT_TEXT_ALIGN_LEFT);
+        CHECK(utxt_layout_add_glyphs(layout, font, str) == expected.glyphs.size());
+        utxt_layout_compute(layout);
+        const auto contents = get_layout_contents(layout, font);
+        CHECK(contents.glyphs == expected.glyphs);
+        CHECK(contents.text_offsets == expected.text_offsets);
+        utxt_layout_free(layout);
+
+        // Glyphs that don't fit are dropped, but counted
+        const auto capacity = next_random(rng) % (expected.glyphs.size() + 1);
+        utxt_layout* fixed = utxt_layout_create({}, (uint32_t)capacity);
+        utxt_layout_reset(fixed, wrap_width, UTXT_TEXT_ALIGN_LEFT);
+        CHECK(utxt_layout_add_glyphs(fixed, font, str) == capacity);
+        CHECK(utxt_layout_get_required_capacity(fixed) == expected.glyphs.size());
+        utxt_layout_compute(fixed);
+        const auto fixed_contents = get_layout_contents(fixed, font);
+        CHECK(std::equal(fixed_contents.glyphs.begin(), fixed_contents.glyphs.end(),
+            expected.glyphs.begin(), expected.glyphs.begin() + (ptrdiff_t)capacity));
+        CHECK(std::equal(fixed_contents.text_offsets.begin(), fixed_contents.text_offsets.end(),
+            expected.text_offsets.begin(), expected.text_offsets.begin() + (ptrdiff_t)capacity));
+        utxt_layout_free(fixed);
+    }
+}
+
+// Fixed layouts must keep a prefix of the glyphs and count the rest, growing layouts must keep all
+// of them, and shrinking layouts must shrink to what the previous layout required on reset.
+static void test_layout_growth(const utxt_font* font)
+{
+    const uint32_t fixed_capacity = 150;
+    utxt_layout* fixed = utxt_layout_create({}, fixed_capacity);
+    utxt_layout* growing = utxt_layout_create({}, 0);
+    utxt_layout* shrinking = utxt_layout_create({}, 0);
+    utxt_layout_set_growth(growing, UTXT_LAYOUT_GROWTH_GROW);
+    utxt_layout_set_growth(shrinking, UTXT_LAYOUT_GROWTH_SHRINK);
+    CHECK(utxt_layout_get_capacity(fixed) == fixed_capacity);
+    CHECK(utxt_layout_get_capacity(growing) == 0);
+
+    uint32_t rng = 21;
+    size_t prev_required = 0;
+    for (size_t i = 0; i < 40; ++i) {
+        const auto text = random_text(rng, next_random(rng) % 60);
+        const utxt_string str { text.data(), text.size() };
+        const auto wrap_width = 100.0f + (float)(next_random(rng) % 400);
+        const auto expected = get_reference_layout(font, str, wrap_width, UTXT_TEXT_ALIGN_LEFT);
+        const auto required = expected.glyphs.size();
+
+        const auto growing_capacity = utxt_layout_get_capacity(growing);
+        const auto shrinking_capacity = utxt_layout_get_capacity(shrinking);
+        for (const auto layout : { fixed, growing, shrinking }) {
+            utxt_layout_reset(layout, wrap_width, UTXT_TEXT_ALIGN_LEFT);
+            CHECK(utxt_layout_get_required_capacity(layout) == 0);
+        }
+        CHECK(utxt_layout_get_capacity(fixed) == fixed_capacity);
+        CHECK(utxt_layout_get_capacity(growing) == growing_capacity);
+        CHECK(utxt_layout_get_capacity(shrinking) == std::min(shrinking_capacity, prev_required));
+
+        // Added in two parts, so the required capacity is summed up
+        const auto split = std::find(text.begin() + (ptrdiff_t)(text.size() / 2), text.end(), ' ');
+        const utxt_string parts[] = { { text.data(), (size_t)(split - text.begin()) },
+            { text.data() + (split - text.begin()), (size_t)(text.end() - split) } };
+        for (const auto layout : { fixed, growing, shrinking }) {
+            size_t num_added = 0;
+            for (const auto& part : parts) {
+                num_added += utxt_layout_add_text(layout, font, part);
+            }
+            utxt_layout_compute(layout);
+            CHECK(utxt_layout_get_required_capacity(layout) == required);
+            CHECK(utxt_layout_get_capacity(layout) >= num_added);
+            const auto contents = get_layout_contents(layout, font);
+            CHECK(contents.glyphs.size() == num_added);
+            if (layout == fixed) {
+                CHECK(num_added <= fixed_capacity);
+                CHECK(num_added == required || required > fixed_capacity);
+                CHECK(std::equal(contents.glyphs.begin(), contents.glyphs.end(),
+                    expected.glyphs.begin(), expected.glyphs.begin() + (ptrdiff_t)num_added));
+                CHECK(std::equal(contents.text_offsets.begin(), contents.text_offsets.end(),
+                    expected.text_offsets.begin(),
+                    expected.text_offsets.begin() + (ptrdiff_t)num_added));
+            } else {
+                CHECK(contents == expected);
+            }
+        }
+        CHECK(utxt_layout_get_capacity(growing) >= growing_capacity);
+        prev_required = required;
+    }
+    utxt_layout_free(shrinking);
+    utxt_layout_free(growing);
+    utxt_layout_free(fixed);
+}
+
+static void test_word_cache(const utxt_font* font, const utxt_font* kerned_font)
+{
+    // A small vocabulary, so words repeat and hit the cache, with some words too long for it
+    uint32_t rng = 6;
+    std::vector<std::vector<char>> words;
+    for (size_t i = 0; i < 40; ++i) {
+        auto word = random_text(rng, 1);
+        while (word.back() == ' ' || word.back() == '\n') {
+            word.pop_back();
+        }
+        words.push_back(word);
+    }
+    words.push_back({ 'A', 'V', 'A' });
+    words.push_back({ 'T', 'o', 'W', 'e', 'y', '.' });
+    words.push_back(std::vector<char>(17, 'V'));
+
+    for (const uint32_t num_entries : { 1u, 16u, 1024u }) {
+        utxt_word_cache* cache = utxt_word_cache_create({}, num_entries);
+        for (size_t i = 0; i < 20; ++i) {
+            std::vector<char> text;
+            const auto num_words = next_random(rng) % 300;
+            for (size_t w = 0; w < num_words; ++w) {
+                const auto& word = words[next_random(rng) % words.size()];
+                text.insert(text.end(), word.begin(), word.end());
+                text.push_back(next_random(rng) % 10 == 0 ? '\n' : ' ');
+            }
+            const utxt_string str { text.data(), text.size() };
+            const auto wrap_width = 50.0f + (float)(next_random(rng) % 600);
+            const auto align = (utxt_text_align)(i % 3);
+
+            for (const auto f : { font, kerned_font }) {
+                utxt_layout* layout = utxt_layout_create({}, 0);
+                utxt_layout_set_growth(layout, UTXT_LAYOUT_GROWTH_GROW);
+                utxt_layout_set_word_cache(layout, cache);
+                utxt_layout_reset(layout, wrap_width, align);
+                add_text_in_pieces(layout, f, str, rng);
+                CHECK(get_layout_contents(layout, f)
+                    == get_reference_layout(f, str, wrap_width, align));
+                utxt_layout_free(layout);
+
+                // Words are dropped at the same place with and without the cache
+                const auto capacity = next_random(rng) % 200;
+                utxt_layout* cached = utxt_layout_create({}, capacity);
+                utxt_layout* uncached = utxt_layout_create({}, capacity);
+                utxt_layout_set_word_cache(cached, cache);
+                for (const auto l : { cached, uncached }) {
+                    utxt_layout_reset(l, wrap_width, align);
+                    utxt_layout_add_text(l, f, str);
+                    utxt_layout_compute(l);
+                }
+                CHECK(get_layout_contents(cached, f) == get_layout_contents(uncached, f));
+                CHECK(utxt_layout_get_required_capacity(cached)
+                    == utxt_layout_get_required_capacity(uncached));
+                utxt_layout_free(uncached);
+                utxt_layout_free(cached);
+            }
+        }
+        utxt_word_cache_free(cache);
+    }
+
+    // The same word with another font is in the same entry of a cache with a single entry
+    utxt_word_cache* cache = utxt_word_cache_create({}, 1);
+    const utxt_string word = { "AVA ", 4 };
+    for (const auto f : { font, kerned_font, font }) {
+        utxt_layout* layout = utxt_layout_create({}, 16);
+        utxt_layout_set_word_cache(layout, cache);
+        utxt_layout_reset(layout, 0.0f, UTXT_TEXT_ALIGN_LEFT);
+        utxt_layout_add_text(layout, f, word);
+        utxt_layout_compute(layout);
+        CHECK(get_layout_contents(layout, f)
+            == get_reference_layout(f, word, 0.0f, UTXT_TEXT_ALIGN_LEFT));
+        utxt_layout_free(layout);
+    }
+    utxt_word_cache_free(cache);
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        std::fprintf(stderr, "Usage: %s <font.ttf>\n", argv[0]);
+        return 1;
+    }
+    const auto ttf = read_file(argv[1]);
+    if (ttf.empty()) {
+        std::fprintf(stderr, "Could not read %s\n", argv[1]);
+        return 1;
+    }
+
+    test_arena();
+    test_arena_fuzz();
+    test_arena_layout(ttf);
+    test_blend_row_funcs();
+    test_render_batch(ttf);
+    test_shared_font(ttf);
+    test_dynamic_font(ttf);
+    test_dynamic_font_widths(ttf);
+    test_font_blob(ttf);
+    test_draw_text_clipped();
+
+    // Layout tests run with and without kerning
+    utxt_font* font
+        = utxt_font_load_ttf_buffer({}, ttf.data(), ttf.size(), { .size = 20, .atlas_size = 512 });
+    CHECK(font);
+    if (font) {
+        utxt_font* kerned_font = create_kerned_font(font);
+        for (const utxt_font* f : { (const utxt_font*)font, (const utxt_font*)kerned_font }) {
+            test_layout_words(f);
+            test_layout_rewind(f);
+            test_virtual_layout(f);
+            test_layout_parallel(f);
+            test_measure_text(f);
+            test_text_widths(f);
+            test_truncate_text(f);
+            test_layout_hit_test(f);
+            test_quad_buffer(f);
+            test_glyph_instances(f);
+            test_fit_text(f);
+            test_glyph_positions(f);
+            test_layout_glyphs(f);
+            test_layout_growth(f);
+        }
+        test_word_cache(font, kerned_font);
+        test_layout_cache(font, kerned_font);
+        utxt_font_free(kerned_font);
+        utxt_font_free(font);
+    }
+
+    if (num_failures) {
+        std::fprintf(stderr, "%zu checks failed\n", num_failures.load());
+        return 1;
+    }
+    std::printf("All checks passed\n");
+}